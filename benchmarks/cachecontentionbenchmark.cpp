@@ -0,0 +1,143 @@
+#include <QtTest>
+#include <QLoggingCategory>
+
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <cache.h>
+
+using Global::Cache;
+using Global::ItemVersion;
+
+namespace {
+
+constexpr int kEntryCount { 200000 };
+constexpr int kReaderCount { 8 };
+constexpr int kLookupStride { 20 };
+const QString kRepositoryPath { QStringLiteral("/home/user/projects/contention-repository") };
+
+/**
+ * @brief 在后台线程上反复查询 Cache::version()，析构时停止并汇总查询次数
+ */
+class ReaderPool
+{
+public:
+    ReaderPool(int count, const QStringList &lookups)
+    {
+        m_threads.reserve(static_cast<std::size_t>(count));
+        for (int i = 0; i < count; ++i) {
+            m_threads.emplace_back([this, &lookups, i] {
+                quint64 reads { 0 };
+                int index { static_cast<int>(i * 997 % lookups.size()) };
+                while (!m_stop.load(std::memory_order_relaxed)) {
+                    Cache::instance().version(lookups.at(index));
+                    index = (index + 1) % static_cast<int>(lookups.size());
+                    ++reads;
+                }
+                m_reads.fetch_add(reads, std::memory_order_relaxed);
+            });
+        }
+    }
+
+    ~ReaderPool() { stop(); }
+
+    quint64 stop()
+    {
+        m_stop.store(true);
+        for (std::thread &thread : m_threads) {
+            if (thread.joinable())
+                thread.join();
+        }
+        return m_reads.load();
+    }
+
+private:
+    std::vector<std::thread> m_threads;
+    std::atomic<bool> m_stop { false };
+    std::atomic<quint64> m_reads { 0 };
+};
+
+}   // namespace
+
+/**
+ * @brief 20 万条目的仓库整表重新发布时，8 个读者线程查询状态的开销
+ *
+ * 读者使用线程本地缓存的快照，只在每次发布后复制一次指针，不应因写者构建新状态而排队等待。
+ */
+class CacheContentionBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void republishWithReaders();
+    void lookupsDuringRepublish();
+
+private:
+    QHash<QString, ItemVersion> m_versions;
+    QStringList m_lookups;
+};
+
+void CacheContentionBenchmark::initTestCase()
+{
+    // resetVersion() 每次都会输出调试日志
+    QLoggingCategory::setFilterRules(QStringLiteral("*.debug=false"));
+
+    m_versions.reserve(kEntryCount);
+    for (int i = 0; i < kEntryCount; ++i) {
+        const QString &path { kRepositoryPath + QStringLiteral("/src/module-%1/file-%2.cpp").arg(i / 1000).arg(i % 1000) };
+        m_versions.insert(path, i % 3 ? ItemVersion::IgnoredVersion : ItemVersion::LocallyModifiedUnstagedVersion);
+        if (i % kLookupStride == 0)
+            m_lookups.append(path);
+    }
+    Cache::instance().resetVersion(kRepositoryPath, m_versions);
+}
+
+void CacheContentionBenchmark::republishWithReaders()
+{
+    ReaderPool readers(kReaderCount, m_lookups);
+    QElapsedTimer timer;
+    timer.start();
+
+    QBENCHMARK {
+        Cache::instance().resetVersion(kRepositoryPath, m_versions);
+    }
+
+    const quint64 reads { readers.stop() };
+    qInfo() << kReaderCount << "readers completed" << reads << "lookups in" << timer.elapsed() << "ms";
+}
+
+void CacheContentionBenchmark::lookupsDuringRepublish()
+{
+    // 当前线程是第 8 个读者，写者线程持续整表重新发布
+    ReaderPool readers(kReaderCount - 1, m_lookups);
+    std::atomic<bool> stopWriter { false };
+    std::atomic<int> republishes { 0 };
+    std::thread writer([this, &stopWriter, &republishes] {
+        while (!stopWriter.load(std::memory_order_relaxed)) {
+            Cache::instance().resetVersion(kRepositoryPath, m_versions);
+            republishes.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    int modified { 0 };
+    QBENCHMARK {
+        modified = 0;
+        for (const QString &path : std::as_const(m_lookups)) {
+            if (Cache::instance().version(path) == ItemVersion::LocallyModifiedUnstagedVersion)
+                ++modified;
+        }
+    }
+
+    stopWriter.store(true);
+    writer.join();
+    readers.stop();
+    QVERIFY(modified > 0);
+    qInfo() << m_lookups.size() << "lookups per iteration," << republishes.load() << "republishes meanwhile";
+}
+
+QTEST_GUILESS_MAIN(CacheContentionBenchmark)
+
+#include "cachecontentionbenchmark.moc"
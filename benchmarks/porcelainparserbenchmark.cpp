@@ -0,0 +1,119 @@
+#include <QtTest>
+
+#include <gitporcelainparser.h>
+
+namespace {
+
+constexpr int kRecordCount { 1000000 };
+
+/**
+ * @brief 生成 `git status --porcelain -z` 的输出，混合修改、未跟踪、被忽略以及带原路径的重命名记录
+ */
+QByteArray statusOutput()
+{
+    QByteArray output;
+    output.reserve(kRecordCount * 48);
+    for (int i = 0; i < kRecordCount; ++i) {
+        const QByteArray &path { "src/module-" + QByteArray::number(i / 1000) + "/file-" + QByteArray::number(i % 1000) + ".cpp" };
+        switch (i % 10) {
+        case 0:
+            output += "R  " + path + '\0' + path + ".orig" + '\0';
+            break;
+        case 1:
+        case 2:
+            output += " M " + path + '\0';
+            break;
+        case 3:
+            output += "?? " + path + '\0';
+            break;
+        default:
+            output += "!! " + path + '\0';
+            break;
+        }
+    }
+    return output;
+}
+
+}   // namespace
+
+/**
+ * @brief 100 万条记录的 porcelain 输出按 QProcess 读取的块大小喂给解析器的开销
+ */
+class PorcelainParserBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void parse_data();
+    void parse();
+    void parseAndDecode_data();
+    void parseAndDecode();
+
+private:
+    QByteArray m_output;
+};
+
+void PorcelainParserBenchmark::initTestCase()
+{
+    m_output = statusOutput();
+}
+
+void PorcelainParserBenchmark::parse_data()
+{
+    QTest::addColumn<int>("chunkSize");
+    QTest::newRow("4 KiB") << 4096;
+    QTest::newRow("64 KiB") << 65536;
+}
+
+void PorcelainParserBenchmark::parse()
+{
+    QFETCH(int, chunkSize);
+    std::size_t records { 0 };
+    std::size_t pathBytes { 0 };
+
+    QBENCHMARK {
+        GitPorcelainParser parser;
+        pathBytes = 0;
+        auto handler = [&pathBytes](char, char, std::string_view path) {
+            pathBytes += path.size();
+        };
+        for (int offset = 0; offset < m_output.size(); offset += chunkSize)
+            parser.feed(m_output.constData() + offset, static_cast<std::size_t>(qMin(chunkSize, static_cast<int>(m_output.size()) - offset)), handler);
+        parser.finish(handler);
+        records = parser.recordCount();
+    }
+
+    QCOMPARE(records, static_cast<std::size_t>(kRecordCount));
+    QVERIFY(pathBytes > 0);
+}
+
+void PorcelainParserBenchmark::parseAndDecode_data()
+{
+    parse_data();
+}
+
+void PorcelainParserBenchmark::parseAndDecode()
+{
+    // 与 GitVersionWorker 一样只解码需要记录的路径，并写入结果表
+    QFETCH(int, chunkSize);
+    QHash<QString, char> states;
+
+    QBENCHMARK {
+        GitPorcelainParser parser;
+        states.clear();
+        states.reserve(kRecordCount);
+        auto handler = [&states](char X, char Y, std::string_view path) {
+            states.insert(QString::fromUtf8(path.data(), static_cast<int>(path.size())), X == ' ' ? Y : X);
+        };
+        for (int offset = 0; offset < m_output.size(); offset += chunkSize)
+            parser.feed(m_output.constData() + offset, static_cast<std::size_t>(qMin(chunkSize, static_cast<int>(m_output.size()) - offset)), handler);
+        parser.finish(handler);
+    }
+
+    QCOMPARE(static_cast<int>(states.size()), kRecordCount);
+}
+
+QTEST_GUILESS_MAIN(PorcelainParserBenchmark)
+
+#include "porcelainparserbenchmark.moc"
@@ -0,0 +1,107 @@
+#include <QtTest>
+
+#include <malloc.h>
+
+#include <repositorysnapshot.h>
+
+using Global::ItemVersion;
+using Global::RepositorySnapshot;
+
+namespace {
+
+constexpr int kEntryCount { 500000 };
+const QString kRepositoryPath { QStringLiteral("/home/user/projects/sample-repository") };
+
+// 形如 node_modules 下的依赖树，500 个条目一个包
+QString relativePath(int index)
+{
+    return QStringLiteral("node_modules/package-%1/lib/module-%2.js")
+            .arg(index / 500, 5, 10, QLatin1Char('0'))
+            .arg(index % 500, 3, 10, QLatin1Char('0'));
+}
+
+QString absolutePath(int index)
+{
+    QString path { kRepositoryPath + QLatin1Char('/') + relativePath(index) };
+    // 拼接时预留的容量不计入，得到旧布局的下限
+    path.squeeze();
+    return path;
+}
+
+/**
+ * @brief 当前进程的堆占用：arena 中的小块加上单独 mmap 的大块（桶数组、条目数组、字符串池）
+ */
+std::size_t heapInUse()
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    const struct mallinfo2 info { mallinfo2() };
+#else
+    const struct mallinfo info { mallinfo() };
+#endif
+    return static_cast<std::size_t>(info.uordblks) + static_cast<std::size_t>(info.hblkhd);
+}
+
+void reportHeap(const char *layout, std::size_t bytes)
+{
+    qInfo().noquote() << QStringLiteral("%1: %2 MB for %3 entries, %4 bytes per entry")
+                                 .arg(QLatin1String(layout))
+                                 .arg(static_cast<double>(bytes) / (1024 * 1024), 0, 'f', 1)
+                                 .arg(kEntryCount)
+                                 .arg(static_cast<double>(bytes) / kEntryCount, 0, 'f', 1);
+    QTest::setBenchmarkResult(static_cast<qreal>(bytes), QTest::BytesAllocated);
+}
+
+}   // namespace
+
+/**
+ * @brief 对比旧的 QHash<QString, ItemVersion> 与 StatusTable 快照在 50 万条目下的内存占用
+ *
+ * 两种布局都以构建前后 glibc 报告的堆占用之差计量，临时对象在计量前释放。
+ */
+class StatusTableMemoryBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void versionHash();
+    void repositorySnapshot();
+};
+
+void StatusTableMemoryBenchmark::versionHash()
+{
+    malloc_trim(0);
+    const std::size_t before { heapInUse() };
+    // 与 GitDirectoryStateTree::toVersionHash() 一样预留容量
+    RepositorySnapshot::VersionHash versions;
+    versions.reserve(kEntryCount);
+    for (int i = 0; i < kEntryCount; ++i)
+        versions.insert(absolutePath(i), ItemVersion::IgnoredVersion);
+    const std::size_t used { heapInUse() - before };
+
+    QCOMPARE(static_cast<int>(versions.size()), kEntryCount);
+    reportHeap("QHash<QString, ItemVersion>", used);
+}
+
+void StatusTableMemoryBenchmark::repositorySnapshot()
+{
+    malloc_trim(0);
+    const std::size_t before { heapInUse() };
+    std::unique_ptr<RepositorySnapshot> snapshot;
+    {
+        RepositorySnapshot::VersionHash versions;
+        versions.reserve(kEntryCount);
+        for (int i = 0; i < kEntryCount; ++i)
+            versions.insert(absolutePath(i), ItemVersion::IgnoredVersion);
+        snapshot.reset(new RepositorySnapshot(kRepositoryPath, std::move(versions)));
+    }
+    const std::size_t used { heapInUse() - before };
+
+    QCOMPARE(snapshot->size(), kEntryCount);
+    QCOMPARE(snapshot->version(absolutePath(kEntryCount - 1)), ItemVersion::IgnoredVersion);
+    qInfo() << "RepositorySnapshot::memoryUsage():" << snapshot->memoryUsage();
+    reportHeap("StatusTable", used);
+}
+
+QTEST_GUILESS_MAIN(StatusTableMemoryBenchmark)
+
+#include "statustablememorybenchmark.moc"
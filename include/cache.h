@@ -1,11 +1,17 @@
 #ifndef CACHE_H
 #define CACHE_H
 
+#include <atomic>
+#include <memory>
+
 #include <QMutexLocker>
 
 #include <global.h>
+#include <pathindex.h>
+#include <repositorysnapshot.h>
 
 namespace Global {
+
 class Cache : public QObject
 {
     Q_OBJECT
@@ -14,18 +20,41 @@ class Cache : public QObject
 public:
     static Cache &instance();
 
-    void resetVersion(const QString &repositoryPath, QHash<QString, ItemVersion> versionInfo);
+    quint64 resetVersion(const QString &repositoryPath, QHash<QString, ItemVersion> versionInfo);
+    bool applyDelta(const VersionDelta &delta);
+    bool restoreSnapshot(RepositorySnapshotPtr snapshot);
     void removeVersion(const QString &repositoryPath);
     ItemVersion version(const QString &filePath);
+    QString findRepository(const QString &filePath, bool includeSelf = true);
+    RepositorySnapshotPtr snapshot(const QString &repositoryPath);
     QStringList allRepositoryPaths();
 
 private:
     explicit Cache(QObject *parent = nullptr);
 
+    // 整个缓存的只读视图，写者复制后整体替换（RCU）
+    struct State
+    {
+        // 仓库路径前缀树，用于最长前缀匹配（嵌套仓库命中最内层）
+        std::shared_ptr<const PathIndex> repositoryIndex;
+        // repository path -> snapshot
+        QHash<QString, RepositorySnapshotPtr> repositories;
+    };
+    using StatePtr = std::shared_ptr<const State>;
+
+    // 返回的引用由线程本地缓存持有，在本线程下一次调用 loadState() 之前有效
+    const State &loadState() const;
+    // 调用方须持有 m_writeMutex
+    void publishState(StatePtr state);
+
 private:
-    QMutex m_mutex;   // 一把大锁保平安
-    // repository path -> { file path, version }
-    QHash<QString, QHash<QString, ItemVersion>> m_repositories;
+    // 写者之间互斥，构建新状态期间一直持有；读者从不获取此锁
+    QMutex m_writeMutex;
+    // 只保护 m_state 指针本身的复制与替换。读者仅在发布后首次读取时获取，持有时间为一次引用计数操作
+    mutable QMutex m_stateMutex;
+    StatePtr m_state;
+    // 每次发布后递增。与线程本地缓存的代数一致时读者直接使用缓存的状态，不加锁也不写共享内存
+    std::atomic<quint64> m_stateGeneration { 1 };
 };
 
 }   // namespace Global
@@ -0,0 +1,67 @@
+#ifndef PATHINDEX_H
+#define PATHINDEX_H
+
+#include <vector>
+#include <utility>
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+
+namespace Global {
+
+/**
+ * @brief 基于路径组件的前缀树（trie），用于仓库路径的最长前缀匹配
+ *
+ * 每个节点对应一级目录名，子节点按名称排序后二分查找，
+ * 查询时直接在原始路径上以 QStringView 切片比较，不产生临时字符串。
+ * 查询复杂度为 O(depth * log(children))，与已注册路径总数无关，
+ * 嵌套仓库总是命中最内层的那一个。
+ *
+ * 本类不是线程安全的，由调用方负责同步。
+ */
+class PathIndex
+{
+public:
+    PathIndex();
+
+    void insert(const QString &path);
+    bool remove(const QString &path);
+    bool contains(const QString &path) const;
+    void clear();
+
+    /**
+     * @brief 查找包含 path 的最长已注册路径
+     * @param path 待查询的绝对路径
+     * @param includeSelf 为 false 时不匹配与 path 完全相同的注册路径
+     * @return 命中的注册路径，未命中返回空字符串
+     */
+    QString longestPrefix(const QString &path, bool includeSelf = true) const;
+
+    QStringList paths() const;
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+private:
+    struct Node
+    {
+        QString name;
+        QString path;   // 仅在 terminal 为 true 时有效
+        std::vector<std::pair<QString, int>> children;   // 按名称排序
+        int parent { -1 };
+        bool terminal { false };
+    };
+
+    int findChild(int node, QStringView name) const;
+    int findNode(const QString &path) const;
+    int allocateNode(const QString &name, int parent);
+    void releaseNode(int node);
+
+    std::vector<Node> m_nodes;
+    std::vector<int> m_freeNodes;
+    int m_size { 0 };
+};
+
+}   // namespace Global
+
+#endif   // PATHINDEX_H
@@ -0,0 +1,90 @@
+#ifndef REPOSITORYSNAPSHOT_H
+#define REPOSITORYSNAPSHOT_H
+
+#include <memory>
+#include <functional>
+
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVarLengthArray>
+
+#include <global.h>
+#include <statustable.h>
+
+namespace Global {
+
+/**
+ * @brief 一次增量更新：新增/变化的路径、移除的路径，以及应用后的仓库代数
+ *
+ * generation 必须恰好比缓存中当前快照的代数大 1，否则说明增量基于过期快照，
+ * 会被拒绝，调用方应回退到整表 resetVersion。
+ */
+struct VersionDelta
+{
+    QString repositoryPath;
+    quint64 generation { 0 };
+    QHash<QString, ItemVersion> changed;   // added or changed
+    QSet<QString> removed;
+
+    bool isEmpty() const { return changed.isEmpty() && removed.isEmpty(); }
+};
+
+/**
+ * @brief 单个仓库的不可变状态快照
+ *
+ * 由共享的基础表和一个较小的覆盖层组成：增量只复制覆盖层，
+ * 覆盖层超过阈值时才合并回基础表，因此单次更新的代价与变化量成正比。
+ * 基础表为 StatusTable，以仓库相对路径存储，对外接口仍使用绝对路径。
+ * 快照一经发布便不再修改，读者持有 shared_ptr 即可在无锁的情况下安全访问。
+ */
+class RepositorySnapshot
+{
+public:
+    using VersionHash = QHash<QString, ItemVersion>;
+
+    RepositorySnapshot(const QString &repositoryPath, VersionHash versions, quint64 generation = 0);
+    RepositorySnapshot(const QString &repositoryPath, std::shared_ptr<const StatusTable> table, quint64 generation = 0);
+
+    std::shared_ptr<const RepositorySnapshot> applied(const VersionDelta &delta) const;
+
+    const QString &repositoryPath() const { return m_repositoryPath; }
+    quint64 generation() const { return m_generation; }
+
+    ItemVersion version(const QString &filePath) const;
+    bool contains(const QString &filePath) const;
+    int size() const;
+    void forEach(const std::function<void(const QString &, ItemVersion)> &visitor) const;
+    VersionHash toHash() const;
+    std::size_t memoryUsage() const;
+
+    /**
+     * @brief 返回合并了覆盖层的完整状态表（无覆盖层时直接共享基础表）
+     */
+    std::shared_ptr<const StatusTable> compactedTable() const;
+
+private:
+    RepositorySnapshot() = default;
+
+    // 查找时的相对路径键，常见长度的路径在栈上编码，不分配堆内存
+    using KeyBuffer = QVarLengthArray<char, 256>;
+
+    bool relativeKey(const QString &filePath, KeyBuffer *key) const;
+    QString absolutePath(std::string_view relativePath) const;
+
+    QString m_repositoryPath;
+    quint64 m_generation { 0 };
+    std::shared_ptr<const StatusTable> m_base;
+    VersionHash m_overlay;   // 相对基础表新增或变化的条目
+    QSet<QString> m_removed;   // 相对基础表移除的条目
+    int m_size { 0 };
+
+    static constexpr int MAX_OVERLAY_SIZE = 4096;
+};
+using RepositorySnapshotPtr = std::shared_ptr<const RepositorySnapshot>;
+
+}   // namespace Global
+
+#endif   // REPOSITORYSNAPSHOT_H
@@ -0,0 +1,78 @@
+#ifndef STATUSTABLE_H
+#define STATUSTABLE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Global {
+
+/**
+ * @brief 紧凑的仓库状态表
+ *
+ * 以仓库相对路径（UTF-8）为键、单字节状态为值的只追加表：
+ * - 所有路径连续存放在同一块字符串池（arena）中，条目只记录偏移和长度
+ * - 索引为开放寻址的稠密哈希，槽位只存 32 位条目下标
+ * 相比 QHash<QString, ItemVersion>，每个条目省去了一次堆分配和 UTF-16 的双倍空间。
+ *
+ * 构建完成后只读，可被多个线程同时查询。
+ */
+class StatusTable
+{
+public:
+    void reserve(std::size_t entries, std::size_t arenaBytes);
+    void insert(std::string_view relativePath, std::uint8_t state);
+    bool find(std::string_view relativePath, std::uint8_t *state = nullptr) const;
+
+    template<typename Function>
+    void forEach(Function &&function) const
+    {
+        for (const Entry &entry : m_entries)
+            function(std::string_view(m_arena.data() + entry.offset, entry.length), entry.state);
+    }
+
+    /**
+     * @brief 平铺的内存布局（条目数组与字符串池），用于持久化以及从内存映射文件中加载
+     *
+     * 索引槽位不持久化，加载时由条目重建：磁盘上的数据不可信，损坏的槽位可能使探测永不结束。
+     */
+    struct RawLayout
+    {
+        const void *entries { nullptr };
+        std::size_t entryCount { 0 };
+        const char *arena { nullptr };
+        std::size_t arenaBytes { 0 };
+    };
+    RawLayout rawLayout() const;
+    static bool fromRawLayout(const RawLayout &layout, StatusTable *table);
+    static constexpr std::size_t entrySize() { return sizeof(Entry); }
+
+    std::size_t size() const { return m_entries.size(); }
+    bool isEmpty() const { return m_entries.empty(); }
+    std::size_t memoryUsage() const;
+
+private:
+    struct Entry
+    {
+        std::uint32_t offset;
+        std::uint32_t hash;
+        std::uint16_t length;
+        std::uint8_t state;
+        std::uint8_t reserved;   ///< 填充字节，条目数组会原样写盘并参与校验，始终为 0
+    };
+
+    static std::uint32_t hashOf(std::string_view key);
+    std::int64_t findEntry(std::string_view key, std::uint32_t hash) const;
+    void rehash(std::size_t slotCount);
+    static std::size_t slotCountFor(std::size_t entries);
+
+    std::string m_arena;
+    std::vector<Entry> m_entries;
+    std::vector<std::uint32_t> m_slots;   // 0 表示空槽，否则为条目下标 + 1
+};
+
+}   // namespace Global
+
+#endif   // STATUSTABLE_H
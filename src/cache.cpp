@@ -10,53 +10,165 @@ Cache &Cache::instance()
     return ins;
 }
 
-void Cache::resetVersion(const QString &repositoryPath, QHash<QString, ItemVersion> versionInfo)
+quint64 Cache::resetVersion(const QString &repositoryPath, QHash<QString, ItemVersion> versionInfo)
 {
-    QMutexLocker locker { &m_mutex };
+    QMutexLocker locker { &m_writeMutex };
+    const StatePtr current { m_state };
     // 总是插入/更新仓库信息，即使versionInfo为空
     // 这确保干净仓库的路径也会被记录，便于后续查询
-    if (!m_repositories.contains(repositoryPath) || m_repositories.value(repositoryPath) != versionInfo) {
-        m_repositories.insert(repositoryPath, versionInfo);
-        qDebug() << "[Cache::resetVersion] Updated repository:" << repositoryPath
-                 << "with" << versionInfo.size() << "version entries";
+    auto it = current->repositories.constFind(repositoryPath);
+    const bool isNew { it == current->repositories.constEnd() };
+    const quint64 generation { isNew ? 1 : (*it)->generation() + 1 };
+    const int entries { static_cast<int>(versionInfo.size()) };
+
+    auto next { std::make_shared<State>(*current) };
+    if (isNew) {
+        auto index { std::make_shared<PathIndex>(*current->repositoryIndex) };
+        index->insert(repositoryPath);
+        next->repositoryIndex = std::move(index);
     }
+    next->repositories.insert(repositoryPath,
+                              std::make_shared<const RepositorySnapshot>(repositoryPath, std::move(versionInfo), generation));
+    publishState(std::move(next));
+
+    qDebug() << "[Cache::resetVersion] Updated repository:" << repositoryPath
+             << "with" << entries << "version entries";
+    return generation;
+}
+
+bool Cache::applyDelta(const VersionDelta &delta)
+{
+    QMutexLocker locker { &m_writeMutex };
+    const StatePtr current { m_state };
+    auto it = current->repositories.constFind(delta.repositoryPath);
+    if (it == current->repositories.constEnd()) {
+        qWarning() << "WARNING: [Cache::applyDelta] Unknown repository:" << delta.repositoryPath;
+        return false;
+    }
+
+    // 增量必须基于当前快照生成，否则拒绝，由调用方回退到整表重置
+    if (delta.generation != (*it)->generation() + 1) {
+        qDebug() << "[Cache::applyDelta] Rejected stale delta for:" << delta.repositoryPath
+                 << "delta generation:" << delta.generation << "current:" << (*it)->generation();
+        return false;
+    }
+
+    auto next { std::make_shared<State>(*current) };
+    next->repositories.insert(delta.repositoryPath, (*it)->applied(delta));
+    publishState(std::move(next));
+
+    qDebug() << "[Cache::applyDelta] Applied delta to repository:" << delta.repositoryPath
+             << "changed:" << delta.changed.size() << "removed:" << delta.removed.size();
+    return true;
+}
+
+bool Cache::restoreSnapshot(RepositorySnapshotPtr snapshot)
+{
+    Q_ASSERT(snapshot);
+    const QString &repositoryPath { snapshot->repositoryPath() };
+
+    QMutexLocker locker { &m_writeMutex };
+    const StatePtr current { m_state };
+    // 持久化快照只用于填补空白，不能覆盖已经检索到的实时结果
+    if (current->repositories.contains(repositoryPath))
+        return false;
+
+    auto next { std::make_shared<State>(*current) };
+    auto index { std::make_shared<PathIndex>(*current->repositoryIndex) };
+    index->insert(repositoryPath);
+    next->repositoryIndex = std::move(index);
+    next->repositories.insert(repositoryPath, std::move(snapshot));
+    publishState(std::move(next));
+
+    qDebug() << "[Cache::restoreSnapshot] Restored repository:" << repositoryPath;
+    return true;
 }
 
 void Cache::removeVersion(const QString &repositoryPath)
 {
-    QMutexLocker locker { &m_mutex };
-    if (m_repositories.contains(repositoryPath))
-        m_repositories.remove(repositoryPath);
+    QMutexLocker locker { &m_writeMutex };
+    const StatePtr current { m_state };
+    if (!current->repositories.contains(repositoryPath))
+        return;
+
+    auto next { std::make_shared<State>(*current) };
+    auto index { std::make_shared<PathIndex>(*current->repositoryIndex) };
+    index->remove(repositoryPath);
+    next->repositoryIndex = std::move(index);
+    next->repositories.remove(repositoryPath);
+    publishState(std::move(next));
 }
 
 ItemVersion Cache::version(const QString &filePath)
 {
     Q_ASSERT(!filePath.isEmpty());
     ItemVersion version { ItemVersion::NormalVersion };
-    QMutexLocker locker { &m_mutex };
-    const auto &allPaths { m_repositories.keys() };
-    auto it = std::find_if(allPaths.begin(), allPaths.end(), [&filePath](const QString &repositoryPath) {
-        return filePath.startsWith(repositoryPath + '/') || filePath == repositoryPath;
-    });
-    if (it == allPaths.end())
+    // 线程本地缓存持有 state 期间其引用的索引和快照都不会被释放
+    const State &state { loadState() };
+    const QString &repositoryPath { state.repositoryIndex->longestPrefix(filePath) };
+    if (repositoryPath.isEmpty())
         return version;
 
-    const auto &versionInfoHash { m_repositories.value(*it) };
-    if (versionInfoHash.contains(filePath))
-        version = versionInfoHash.value(filePath);
+    auto repositoryIt = state.repositories.constFind(repositoryPath);
+    if (repositoryIt == state.repositories.constEnd())
+        return version;
+
+    return (*repositoryIt)->version(filePath);
+}
+
+QString Cache::findRepository(const QString &filePath, bool includeSelf)
+{
+    return loadState().repositoryIndex->longestPrefix(filePath, includeSelf);
+}
 
-    return version;
+RepositorySnapshotPtr Cache::snapshot(const QString &repositoryPath)
+{
+    return loadState().repositories.value(repositoryPath);
 }
 
 QStringList Cache::allRepositoryPaths()
 {
-    QMutexLocker locker { &m_mutex };
-    return m_repositories.keys();
+    return loadState().repositories.keys();
+}
+
+const Cache::State &Cache::loadState() const
+{
+    // 代数未变时只有一次原子读取；空闲线程会保留一份旧状态，直到它下一次读取或退出
+    struct LocalState
+    {
+        quint64 generation { 0 };
+        StatePtr state;
+    };
+    thread_local LocalState local;
+
+    // 先读代数再复制指针：写者先替换指针再递增代数，复制到的状态不会比记录的代数旧
+    const quint64 generation { m_stateGeneration.load(std::memory_order_acquire) };
+    if (local.generation != generation) {
+        // 旧状态可能是最后一个引用，在锁外释放
+        const StatePtr previous { std::move(local.state) };
+        QMutexLocker locker { &m_stateMutex };
+        local.state = m_state;
+        local.generation = generation;
+    }
+    return *local.state;
+}
+
+void Cache::publishState(StatePtr state)
+{
+    {
+        QMutexLocker locker { &m_stateMutex };
+        m_state.swap(state);
+    }
+    m_stateGeneration.fetch_add(1, std::memory_order_release);
+    // 旧状态（此时在 state 中）在锁外释放
 }
 
 Cache::Cache(QObject *parent)
     : QObject { parent }
 {
+    auto initial { std::make_shared<State>() };
+    initial->repositoryIndex = std::make_shared<PathIndex>();
+    m_state = std::move(initial);
 }
 
 }   // namespace Global
@@ -19,6 +19,7 @@
 #include <QKeyEvent>
 #include <QUrl>
 #include <QTimer>
+#include <QDateTime>
 
 GitBlameDialog::GitBlameDialog(const QString &repositoryPath, const QString &filePath, QWidget *parent)
     : QDialog(parent), m_repositoryPath(repositoryPath), m_filePath(filePath), m_fileName(QFileInfo(filePath).fileName()), m_currentSelectedLine(-1), m_contextMenu(nullptr), m_showCommitDetailsAction(nullptr), m_filePathLabel(nullptr), m_blameTextEdit(nullptr), m_refreshButton(nullptr), m_closeButton(nullptr), m_progressBar(nullptr), m_statusLabel(nullptr), m_nextColorIndex(0)
@@ -578,64 +579,60 @@ void GitBlameDialog::showCommitDetailsDialog(const QString &hash)
     // 显示对话框
     commitDialog->show();
 
-    // 加载提交详情
+    // 一次 git show 同时取得提交信息和差异，提交信息的格式（编码、缩写长度、日期）完全由 git 决定
     QProcess process;
     process.setWorkingDirectory(m_repositoryPath);
 
-    // 获取提交的完整信息
     QStringList args;
     args << "show"
          << "--format=fuller"
-         << "--no-patch" << hash;
-
-    process.start("git", args);
-    if (process.waitForFinished(10000)) {
-        const QString commitInfo = QString::fromUtf8(process.readAllStandardOutput());
-        if (!commitInfo.isEmpty()) {
-            commitInfoEdit->setPlainText(commitInfo);
-            qInfo() << "INFO: [GitBlameDialog::showCommitDetailsDialog] Loaded commit info for" << hash.left(8);
-        } else {
-            commitInfoEdit->setPlainText(tr("No commit information available."));
-            qWarning() << "WARNING: [GitBlameDialog::showCommitDetailsDialog] Empty commit info for" << hash;
-        }
-    } else {
-        commitInfoEdit->setPlainText(tr("Failed to load commit information: %1").arg(process.errorString()));
-        qCritical() << "ERROR: [GitBlameDialog::showCommitDetailsDialog] Failed to load commit info:" << process.errorString();
-    }
-
-    // 获取提交的文件差异
-    QProcess diffProcess;
-    diffProcess.setWorkingDirectory(m_repositoryPath);
-
-    QStringList diffArgs;
-    diffArgs << "show"
-             << "--color=never" << hash;
+         << "--color=never" << hash;
     if (!m_filePath.isEmpty()) {
         // 如果有指定文件，只显示该文件的差异
         QDir repoDir(m_repositoryPath);
         QString relativePath = repoDir.relativeFilePath(m_filePath);
-        diffArgs << "--" << relativePath;
+        args << "--" << relativePath;
         infoLabel->setText(tr("Commit: %1 - File: %2").arg(hash.left(8), relativePath));
     } else {
         infoLabel->setText(tr("Commit: %1 - All changes").arg(hash.left(8)));
     }
 
-    diffProcess.start("git", diffArgs);
-    if (diffProcess.waitForFinished(15000)) {
-        const QString diffOutput = QString::fromUtf8(diffProcess.readAllStandardOutput());
-        if (!diffOutput.isEmpty()) {
-            diffEdit->setPlainText(diffOutput);
+    process.start("git", args);
+    if (!process.waitForFinished(15000) || process.exitCode() != 0) {
+        const QString error = process.error() == QProcess::UnknownError
+                ? QString::fromUtf8(process.readAllStandardError()).trimmed()
+                : process.errorString();
+        commitInfoEdit->setPlainText(tr("Failed to load commit information: %1").arg(error));
+        diffEdit->setPlainText(tr("Failed to load commit diff: %1").arg(error));
+        qCritical() << "ERROR: [GitBlameDialog::showCommitDetailsDialog] Failed to run git show:" << error;
+        return;
+    }
+
+    // 提交说明的每一行都带缩进，第一个顶格的 "diff --git"（合并提交为 "diff --cc"）就是差异的开始
+    const QString output = QString::fromUtf8(process.readAllStandardOutput());
+    int diffStart = output.startsWith("diff --") ? 0 : static_cast<int>(output.indexOf("\ndiff --"));
+    if (diffStart > 0)
+        ++diffStart;
+    const QString commitInfo = diffStart < 0 ? output : output.left(diffStart);
+    const QString diffOutput = diffStart < 0 ? QString() : output.mid(diffStart);
+
+    if (!commitInfo.trimmed().isEmpty()) {
+        commitInfoEdit->setPlainText(commitInfo.trimmed());
+        qInfo() << "INFO: [GitBlameDialog::showCommitDetailsDialog] Loaded commit info for" << hash.left(8);
+    } else {
+        commitInfoEdit->setPlainText(tr("No commit information available."));
+        qWarning() << "WARNING: [GitBlameDialog::showCommitDetailsDialog] Empty commit info for" << hash;
+    }
 
-            // 应用语法高亮
-            applyDiffSyntaxHighlighting(diffEdit);
-            qInfo() << "INFO: [GitBlameDialog::showCommitDetailsDialog] Loaded diff for" << hash.left(8);
-        } else {
-            diffEdit->setPlainText(tr("No changes found for this commit."));
-            qWarning() << "WARNING: [GitBlameDialog::showCommitDetailsDialog] Empty diff for" << hash;
-        }
+    if (!diffOutput.isEmpty()) {
+        diffEdit->setPlainText(diffOutput);
+
+        // 应用语法高亮
+        applyDiffSyntaxHighlighting(diffEdit);
+        qInfo() << "INFO: [GitBlameDialog::showCommitDetailsDialog] Loaded diff for" << hash.left(8);
     } else {
-        diffEdit->setPlainText(tr("Failed to load commit diff: %1").arg(diffProcess.errorString()));
-        qCritical() << "ERROR: [GitBlameDialog::showCommitDetailsDialog] Failed to load diff:" << diffProcess.errorString();
+        diffEdit->setPlainText(tr("No changes found for this commit."));
+        qWarning() << "WARNING: [GitBlameDialog::showCommitDetailsDialog] Empty diff for" << hash;
     }
 }
 
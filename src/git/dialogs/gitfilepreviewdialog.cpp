@@ -2,6 +2,7 @@
 #include "gitdialogs.h"
 #include "widgets/linenumbertextedit.h"
 #include "widgets/filerenderer.h"
+#include "gitbatchservice.h"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -9,7 +10,6 @@
 #include <QPushButton>
 #include <QFileInfo>
 #include <QDir>
-#include <QProcess>
 #include <QMessageBox>
 #include <QApplication>
 #include <QFont>
@@ -618,36 +618,31 @@ void GitFilePreviewDialog::loadFileContent()
 
 void GitFilePreviewDialog::loadFileContentAtCommit()
 {
-    QProcess process;
-    process.setWorkingDirectory(m_repositoryPath);
-    
-    QStringList args;
-    args << "show" << QString("%1:%2").arg(m_commitHash, m_filePath);
-    
-    qDebug() << "[GitFilePreviewDialog] Loading file content with git command:" << args;
-    
-    process.start("git", args);
-    if (!process.waitForFinished(10000)) {
+    const QString object = QString("%1:%2").arg(m_commitHash, m_filePath);
+    qDebug() << "[GitFilePreviewDialog] Loading file content from object:" << object;
+
+    // 由常驻的 cat-file --batch 进程读取，连续预览多个文件时不再反复启动 git
+    QByteArray data;
+    QByteArray type;
+    if (!GitBatchService::instance().readObject(m_repositoryPath, object, &data, &type) || type != "blob") {
         QString errorMsg = tr("Failed to load file content from Git: %1\nError: %2")
-                           .arg(m_filePath, process.errorString());
+                           .arg(m_filePath, tr("object %1 not found").arg(object));
         m_fileContent = errorMsg;
         m_textEdit->setPlainText(errorMsg);
-        qWarning() << "WARNING: [GitFilePreviewDialog] Git command failed:" << process.errorString();
+        qWarning() << "WARNING: [GitFilePreviewDialog] Failed to read object:" << object << "type:" << type;
         return;
     }
-    
-    if (process.exitCode() != 0) {
-        QString errorOutput = QString::fromUtf8(process.readAllStandardError());
-        QString errorMsg = tr("Git command failed: %1\nError output: %2")
-                           .arg(m_filePath, errorOutput);
-        m_fileContent = errorMsg;
-        m_textEdit->setPlainText(errorMsg);
-        qWarning() << "WARNING: [GitFilePreviewDialog] Git command exit code:" << process.exitCode()
-                   << "Error:" << errorOutput;
+
+    // .gitattributes 中标记为 -diff（binary）的文件不按文本展示
+    const QHash<QString, QString> attributes = GitBatchService::instance().attributes(m_repositoryPath, m_filePath, { "diff" });
+    if (attributes.value("diff") == QLatin1String("unset")) {
+        m_fileContent = tr("Binary file, preview is not available.");
+        m_textEdit->setPlainText(m_fileContent);
+        qDebug() << "[GitFilePreviewDialog] File is marked as binary by gitattributes:" << m_filePath;
         return;
     }
-    
-    QString content = QString::fromUtf8(process.readAllStandardOutput());
+
+    QString content = QString::fromUtf8(data);
     
     if (content.isEmpty()) {
         m_fileContent = tr("File is empty or could not be read from commit %1")
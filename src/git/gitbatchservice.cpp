@@ -0,0 +1,333 @@
+#include "gitbatchservice.h"
+
+#include <mutex>
+#include <vector>
+#include <cstring>
+
+#include <spawn.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <QFile>
+#include <QDateTime>
+#include <QDeadlineTimer>
+#include <QByteArrayList>
+#include <QDebug>
+
+extern char **environ;
+
+/**
+ * @brief 一个长驻的 git 子进程，stdin/stdout 接在同一个 Unix 套接字上
+ *
+ * 使用套接字而不是管道，是为了能以 MSG_NOSIGNAL 写入：子进程意外退出时
+ * 只会得到 EPIPE 错误，不会向文件管理器进程发送 SIGPIPE。
+ * 不是线程安全的，由 GitBatchService 负责串行化。
+ */
+class GitBatchProcess
+{
+public:
+    explicit GitBatchProcess(const QStringList &arguments)
+    {
+        int fds[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+            qWarning() << "WARNING: [GitBatchProcess] socketpair failed:" << std::strerror(errno);
+            return;
+        }
+
+        QByteArrayList encoded { QByteArrayLiteral("git") };
+        for (const QString &argument : arguments)
+            encoded.append(QFile::encodeName(argument));
+        std::vector<char *> argv;
+        for (QByteArray &argument : encoded)
+            argv.push_back(argument.data());
+        argv.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDIN_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+        pid_t pid { -1 };
+        const int error { ::posix_spawnp(&pid, "git", &actions, nullptr, argv.data(), environ) };
+        posix_spawn_file_actions_destroy(&actions);
+        ::close(fds[1]);
+
+        if (error != 0) {
+            qWarning() << "WARNING: [GitBatchProcess] Failed to start git" << arguments << std::strerror(error);
+            ::close(fds[0]);
+            return;
+        }
+
+        m_pid = pid;
+        m_socket = fds[0];
+        qDebug() << "[GitBatchProcess] Started git" << arguments << "pid:" << m_pid;
+    }
+
+    ~GitBatchProcess()
+    {
+        if (m_socket >= 0)
+            ::close(m_socket);
+        if (m_pid > 0) {
+            // 不必等待 git 读完剩余输入，直接结束并回收
+            ::kill(m_pid, SIGKILL);
+            ::waitpid(m_pid, nullptr, 0);
+        }
+    }
+
+    bool isRunning() const { return m_pid > 0 && m_socket >= 0; }
+
+    bool write(const QByteArray &data)
+    {
+        const char *cursor { data.constData() };
+        qint64 remaining { data.size() };
+        while (remaining > 0) {
+            const ssize_t written { ::send(m_socket, cursor, static_cast<size_t>(remaining), MSG_NOSIGNAL) };
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            cursor += written;
+            remaining -= written;
+        }
+        return true;
+    }
+
+    /**
+     * @brief 读取到分隔符为止（不含分隔符）
+     */
+    bool readUntil(char delimiter, QByteArray *out, const QDeadlineTimer &deadline)
+    {
+        for (;;) {
+            const char *begin { m_buffer.constData() + m_offset };
+            const char *found { static_cast<const char *>(std::memchr(begin, delimiter, static_cast<size_t>(m_buffer.size() - m_offset))) };
+            if (found) {
+                *out = QByteArray(begin, static_cast<int>(found - begin));
+                consume(static_cast<int>(found - begin) + 1);
+                return true;
+            }
+            if (!fill(deadline))
+                return false;
+        }
+    }
+
+    /**
+     * @brief 读取固定字节数
+     */
+    bool readBytes(qint64 size, QByteArray *out, const QDeadlineTimer &deadline)
+    {
+        while (m_buffer.size() - m_offset < size) {
+            if (!fill(deadline))
+                return false;
+        }
+        *out = QByteArray(m_buffer.constData() + m_offset, static_cast<int>(size));
+        consume(static_cast<int>(size));
+        return true;
+    }
+
+private:
+    bool fill(const QDeadlineTimer &deadline)
+    {
+        pollfd descriptor { m_socket, POLLIN, 0 };
+        int ready { -1 };
+        do {
+            ready = ::poll(&descriptor, 1, static_cast<int>(deadline.remainingTime()));
+        } while (ready < 0 && errno == EINTR);
+        if (ready <= 0)
+            return false;
+
+        char chunk[65536];
+        ssize_t received { -1 };
+        do {
+            received = ::read(m_socket, chunk, sizeof(chunk));
+        } while (received < 0 && errno == EINTR);
+        if (received <= 0)
+            return false;
+
+        m_buffer.append(chunk, static_cast<int>(received));
+        return true;
+    }
+
+    void consume(int bytes)
+    {
+        m_offset += bytes;
+        if (m_offset == m_buffer.size()) {
+            m_buffer.clear();
+            m_offset = 0;
+        } else if (m_offset > m_buffer.size() / 2) {
+            m_buffer.remove(0, m_offset);
+            m_offset = 0;
+        }
+    }
+
+    pid_t m_pid { -1 };
+    int m_socket { -1 };
+    QByteArray m_buffer;   ///< 已读取但尚未消费的输出
+    int m_offset { 0 };
+};
+
+GitBatchService &GitBatchService::instance()
+{
+    static GitBatchService service;
+    return service;
+}
+
+GitBatchService::~GitBatchService()
+{
+    QMutexLocker locker(&m_mutex);
+    m_helpers.clear();
+}
+
+bool GitBatchService::readObject(const QString &repositoryPath, const QString &object, QByteArray *content,
+                                 QByteArray *type, QByteArray *oid)
+{
+    if (object.isEmpty() || object.contains('\n'))
+        return false;
+
+    const std::shared_ptr<Helper> &helper { acquire(repositoryPath, { "cat-file", "--batch" }) };
+    if (!helper)
+        return false;
+    std::unique_lock<QMutex> lock(helper->mutex, std::adopt_lock);
+
+    const QDeadlineTimer deadline(REQUEST_TIMEOUT_MS);
+    GitBatchProcess &process { *helper->process };
+    QByteArray header;
+    if (!process.write(object.toUtf8() + '\n') || !process.readUntil('\n', &header, deadline)) {
+        qWarning() << "WARNING: [GitBatchService] cat-file request failed:" << repositoryPath << object;
+        helper->process.reset();
+        return false;
+    }
+
+    // "<oid> <type> <size>"，对象不存在时为 "<object> missing" 或 "<object> ambiguous"
+    const int sizeSeparator { header.lastIndexOf(' ') };
+    const int typeSeparator { header.indexOf(' ') };
+    if (sizeSeparator <= typeSeparator || typeSeparator <= 0)
+        return false;
+
+    bool ok { false };
+    const qint64 size { header.mid(sizeSeparator + 1).toLongLong(&ok) };
+    if (!ok || size < 0)
+        return false;
+
+    // 对象内容之后还有一个换行符
+    QByteArray data;
+    if (!process.readBytes(size + 1, &data, deadline)) {
+        qWarning() << "WARNING: [GitBatchService] Truncated cat-file output:" << repositoryPath << object;
+        helper->process.reset();
+        return false;
+    }
+    data.chop(1);
+
+    *content = data;
+    if (type)
+        *type = header.mid(typeSeparator + 1, sizeSeparator - typeSeparator - 1);
+    if (oid)
+        *oid = header.left(typeSeparator);
+    return true;
+}
+
+QHash<QString, QString> GitBatchService::attributes(const QString &repositoryPath, const QString &relativePath,
+                                                    const QStringList &names)
+{
+    QHash<QString, QString> result;
+    if (relativePath.isEmpty() || names.isEmpty())
+        return result;
+
+    // 属性名在命令行上给出，每组属性名对应一个进程
+    const std::shared_ptr<Helper> &helper { acquire(repositoryPath, QStringList { "check-attr", "--stdin", "-z" } + names) };
+    if (!helper)
+        return result;
+    std::unique_lock<QMutex> lock(helper->mutex, std::adopt_lock);
+
+    // 每个属性输出 3 个字段：<path> <attribute> <info>
+    const QDeadlineTimer deadline(REQUEST_TIMEOUT_MS);
+    GitBatchProcess &process { *helper->process };
+    bool ok { process.write(QFile::encodeName(relativePath) + '\0') };
+    for (int i = 0; ok && i < names.size(); ++i) {
+        QByteArray path, attribute, info;
+        ok = process.readUntil('\0', &path, deadline) && process.readUntil('\0', &attribute, deadline)
+                && process.readUntil('\0', &info, deadline);
+        if (ok)
+            result.insert(QString::fromUtf8(attribute), QString::fromUtf8(info));
+    }
+    if (!ok) {
+        qWarning() << "WARNING: [GitBatchService] check-attr request failed:" << repositoryPath << relativePath;
+        helper->process.reset();
+        result.clear();
+    }
+    return result;
+}
+
+void GitBatchService::release(const QString &repositoryPath)
+{
+    const QString &prefix { repositoryPath + '\n' };
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_helpers.begin(); it != m_helpers.end();) {
+        if (it.key().startsWith(prefix)) {
+            QMutexLocker helperLocker(&it.value()->mutex);
+            it.value()->process.reset();
+            helperLocker.unlock();
+            it = m_helpers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::shared_ptr<GitBatchService::Helper> GitBatchService::acquire(const QString &repositoryPath, const QStringList &arguments)
+{
+    if (repositoryPath.isEmpty())
+        return nullptr;
+
+    const qint64 now { QDateTime::currentMSecsSinceEpoch() };
+    std::shared_ptr<Helper> helper;
+    {
+        QMutexLocker locker(&m_mutex);
+        reapIdle(now);
+        auto &slot { m_helpers[repositoryPath + '\n' + arguments.join(' ')] };
+        if (!slot) {
+            slot = std::make_shared<Helper>();
+            slot->lastUsed = now;
+        }
+        helper = slot;
+    }
+
+    helper->mutex.lock();
+    helper->lastUsed = now;
+
+    // HEAD 或 index 变化后，进程中缓存的引用、规则可能已经过期
+    const Utils::RepositoryFingerprint &fingerprint { Utils::readRepositoryFingerprint(repositoryPath) };
+    if (!helper->process || !helper->process->isRunning() || helper->fingerprint != fingerprint) {
+        helper->process.reset();
+        helper->process = std::make_unique<GitBatchProcess>(QStringList { "-C", repositoryPath, "--no-optional-locks" } + arguments);
+        helper->fingerprint = fingerprint;
+        if (!helper->process->isRunning()) {
+            helper->process.reset();
+            helper->mutex.unlock();
+            return nullptr;
+        }
+    }
+    return helper;
+}
+
+void GitBatchService::reapIdle(qint64 now)
+{
+    for (auto it = m_helpers.begin(); it != m_helpers.end();) {
+        Helper &helper { *it.value() };
+        // 正在使用的进程跳过
+        if (!helper.mutex.tryLock()) {
+            ++it;
+            continue;
+        }
+        const bool idle { now - helper.lastUsed > IDLE_TIMEOUT_MS };
+        if (idle)
+            helper.process.reset();
+        helper.mutex.unlock();
+        it = idle ? m_helpers.erase(it) : std::next(it);
+    }
+}
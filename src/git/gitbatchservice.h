@@ -0,0 +1,85 @@
+#ifndef GITBATCHSERVICE_H
+#define GITBATCHSERVICE_H
+
+#include <memory>
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+
+#include "utils.h"
+
+class GitBatchProcess;
+
+/**
+ * @brief 常驻的 git 批处理进程服务
+ *
+ * 为每个仓库按需启动并复用以下长驻进程，避免每次查询都 fork 一个 git：
+ * - `git cat-file --batch`：读取对象内容（提交、rev:path 形式的文件）
+ * - `git check-attr --stdin -z <attr>...`：读取路径属性，每组属性名一个进程
+ *
+ * 可在任意线程调用，同一进程上的请求串行执行。
+ * 每次请求前比较仓库的 index/HEAD 指纹，变化时重启进程以免读到过期的引用和规则；
+ * 闲置超过 IDLE_TIMEOUT_MS 的进程在下次调用时回收。
+ */
+class GitBatchService
+{
+public:
+    static GitBatchService &instance();
+    ~GitBatchService();
+
+    /**
+     * @brief 读取对象内容
+     * @param repositoryPath 仓库根目录
+     * @param object 对象名，如提交哈希或 "<commit>:<path>"
+     * @param content 输出对象内容
+     * @param type 输出对象类型（blob、commit 等），可为空
+     * @param oid 输出完整的对象 id，可为空
+     * @return 对象存在且读取成功返回 true
+     */
+    bool readObject(const QString &repositoryPath, const QString &object, QByteArray *content,
+                    QByteArray *type = nullptr, QByteArray *oid = nullptr);
+
+    /**
+     * @brief 读取路径的 gitattributes
+     * @param repositoryPath 仓库根目录
+     * @param relativePath 相对仓库根目录的路径
+     * @param names 属性名列表
+     * @return 属性名 -> 值（"set"、"unset"、"unspecified" 或具体值），失败返回空
+     */
+    QHash<QString, QString> attributes(const QString &repositoryPath, const QString &relativePath,
+                                       const QStringList &names);
+
+    /**
+     * @brief 结束某个仓库的所有批处理进程
+     * @param repositoryPath 仓库根目录
+     */
+    void release(const QString &repositoryPath);
+
+private:
+    GitBatchService() = default;
+
+    struct Helper
+    {
+        QMutex mutex;   ///< 串行化同一进程上的请求
+        std::unique_ptr<GitBatchProcess> process;
+        Utils::RepositoryFingerprint fingerprint;   ///< 进程启动时的仓库指纹
+        qint64 lastUsed { 0 };
+    };
+
+    /**
+     * @brief 获取（必要时启动或重启）批处理进程，返回时 helper->mutex 已加锁
+     */
+    std::shared_ptr<Helper> acquire(const QString &repositoryPath, const QStringList &arguments);
+    void reapIdle(qint64 now);
+
+    QMutex m_mutex;   ///< 保护 m_helpers
+    QHash<QString, std::shared_ptr<Helper>> m_helpers;   ///< "<repository>\n<arguments>" -> 进程
+
+    static constexpr int REQUEST_TIMEOUT_MS = 5000;   ///< 单次请求的最长等待时间
+    static constexpr qint64 IDLE_TIMEOUT_MS = 60000;   ///< 闲置进程的回收时间
+};
+
+#endif   // GITBATCHSERVICE_H
@@ -1,4 +1,5 @@
 #include "gitcommandexecutor.h"
+#include "gitrepositoryresolver.h"
 
 #include <QDir>
 #include <QFileInfo>
@@ -131,22 +132,11 @@ void GitCommandExecutor::executeCommandAsync(const GitCommand &cmd)
 
 QString GitCommandExecutor::resolveRepositoryPath(const QString &filePath)
 {
-    QFileInfo fileInfo(filePath);
-    QString searchPath = fileInfo.isDir() ? filePath : fileInfo.absolutePath();
-
-    // 使用Git命令查找仓库根目录
-    QProcess process;
-    process.setWorkingDirectory(searchPath);
-    process.start("git", {"rev-parse", "--show-toplevel"});
-    
-    if (process.waitForFinished(3000) && process.exitCode() == 0) {
-        QString repoPath = QString::fromUtf8(process.readAllStandardOutput().trimmed());
-        QDir dir(repoPath);
-        if (dir.exists()) {
-            QString absolutePath = dir.absolutePath();
-            qInfo() << "INFO: [GitCommandExecutor::resolveRepositoryPath] Found repository:" << absolutePath;
-            return absolutePath;
-        }
+    // 直接查找 .git，不启动 git 进程
+    const QString repoPath = GitRepositoryResolver::instance().repositoryRoot(filePath);
+    if (!repoPath.isEmpty()) {
+        qInfo() << "INFO: [GitCommandExecutor::resolveRepositoryPath] Found repository:" << repoPath;
+        return repoPath;
     }
 
     qWarning() << "WARNING: [GitCommandExecutor::resolveRepositoryPath] No repository found for:" << filePath;
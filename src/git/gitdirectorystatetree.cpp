@@ -0,0 +1,322 @@
+#include "gitdirectorystatetree.h"
+
+#include <QStringList>
+#include <QVector>
+#include <QPair>
+
+using Global::ItemVersion;
+
+namespace {
+
+// 文件状态 -> 对所在目录的贡献状态（NormalVersion 表示不贡献），按 ItemVersion 取值索引
+constexpr ItemVersion kDirectoryContribution[] = {
+    ItemVersion::UnversionedVersion,   // UnversionedVersion
+    ItemVersion::NormalVersion,   // NormalVersion
+    ItemVersion::UpdateRequiredVersion,   // UpdateRequiredVersion
+    ItemVersion::LocallyModifiedVersion,   // LocallyModifiedVersion
+    ItemVersion::LocallyModifiedVersion,   // AddedVersion
+    ItemVersion::LocallyModifiedVersion,   // RemovedVersion
+    ItemVersion::ConflictingVersion,   // ConflictingVersion
+    ItemVersion::LocallyModifiedUnstagedVersion,   // LocallyModifiedUnstagedVersion
+    ItemVersion::IgnoredVersion,   // IgnoredVersion
+    ItemVersion::MissingVersion,   // MissingVersion
+};
+static_assert(sizeof(kDirectoryContribution) / sizeof(kDirectoryContribution[0])
+                      == static_cast<int>(ItemVersion::MissingVersion) + 1,
+              "every ItemVersion needs a directory contribution");
+
+// 目录状态优先级（从高到低），仓库根目录不受被忽略文件影响
+struct PriorityRule
+{
+    ItemVersion state;
+    bool affectsRoot;
+};
+constexpr PriorityRule kDirectoryPriority[] = {
+    { ItemVersion::ConflictingVersion, true },
+    { ItemVersion::LocallyModifiedUnstagedVersion, true },
+    { ItemVersion::LocallyModifiedVersion, true },
+    { ItemVersion::UnversionedVersion, true },
+    { ItemVersion::UpdateRequiredVersion, true },
+    { ItemVersion::MissingVersion, true },
+    { ItemVersion::IgnoredVersion, false },
+};
+
+inline ItemVersion contributionOf(ItemVersion state)
+{
+    return kDirectoryContribution[static_cast<int>(state)];
+}
+
+inline QString joinPath(const QString &directory, const QString &name)
+{
+    return directory.isEmpty() ? name : directory + QLatin1Char('/') + name;
+}
+
+}   // namespace
+
+GitDirectoryStateTree::GitDirectoryStateTree(const QString &repositoryPath)
+    : m_repositoryPath { repositoryPath }
+{
+    m_nodes.emplace_back();   // 根节点即仓库根目录
+}
+
+void GitDirectoryStateTree::setFileState(const QString &relativePath, ItemVersion state, Global::VersionDelta *delta)
+{
+    const int slash { relativePath.lastIndexOf(QLatin1Char('/')) };
+    const QString &directory { slash < 0 ? QString() : relativePath.left(slash) };
+    const QString &fileName { relativePath.mid(slash + 1) };
+
+    const int node { state == ItemVersion::NormalVersion ? findNode(directory) : ensureNode(directory) };
+    if (node < 0)
+        return;
+
+    auto &files { m_nodes[node].files };
+    auto it = files.find(fileName);
+    const ItemVersion oldState { it == files.end() ? ItemVersion::NormalVersion : it.value() };
+    if (oldState == state)
+        return;
+
+    if (state == ItemVersion::NormalVersion) {
+        files.erase(it);
+        --m_fileCount;
+    } else if (it == files.end()) {
+        files.insert(fileName, state);
+        ++m_fileCount;
+    } else {
+        it.value() = state;
+    }
+    recordChange(relativePath, state, false, delta);
+
+    // 沿祖先链调整计数，只上报推导结果发生变化的目录
+    const ItemVersion oldContribution { contributionOf(oldState) };
+    const ItemVersion newContribution { contributionOf(state) };
+    if (oldContribution != newContribution) {
+        for (int current = node; current >= 0; current = m_nodes[current].parent) {
+            Node &ancestor { m_nodes[current] };
+            const bool isRoot { current == 0 };
+            const ItemVersion before { deriveState(ancestor, isRoot) };
+            if (oldContribution != ItemVersion::NormalVersion)
+                --ancestor.counts[static_cast<int>(oldContribution)];
+            if (newContribution != ItemVersion::NormalVersion)
+                ++ancestor.counts[static_cast<int>(newContribution)];
+            const ItemVersion after { deriveState(ancestor, isRoot) };
+            if (before != after)
+                recordChange(ancestor.path, after, isRoot, delta);
+        }
+    }
+
+    if (state == ItemVersion::NormalVersion)
+        pruneNode(node);
+}
+
+void GitDirectoryStateTree::replaceAll(const QHash<QString, ItemVersion> &fileStates, Global::VersionDelta *delta)
+{
+    QStringList staleFiles;
+    for (std::size_t i = 0; i < m_nodes.size(); ++i) {
+        const Node &node { m_nodes[i] };
+        for (auto it = node.files.constBegin(); it != node.files.constEnd(); ++it) {
+            const QString &relativePath { joinPath(node.path, it.key()) };
+            if (!fileStates.contains(relativePath))
+                staleFiles.append(relativePath);
+        }
+    }
+
+    for (const QString &relativePath : staleFiles)
+        setFileState(relativePath, ItemVersion::NormalVersion, delta);
+    for (auto it = fileStates.constBegin(); it != fileStates.constEnd(); ++it)
+        setFileState(it.key(), it.value(), delta);
+}
+
+void GitDirectoryStateTree::replaceWithin(const QStringList &scope, const QHash<QString, ItemVersion> &fileStates,
+                                          Global::VersionDelta *delta)
+{
+    // 范围内原有的记录：路径本身（文件）以及路径下的整棵子树（目录）
+    QStringList recorded;
+    for (const QString &path : scope) {
+        if (fileState(path) != ItemVersion::NormalVersion)
+            recorded.append(path);
+        const int node { findNode(path) };
+        if (node > 0)
+            collectFiles(node, &recorded);
+    }
+
+    for (const QString &relativePath : std::as_const(recorded)) {
+        if (!fileStates.contains(relativePath))
+            setFileState(relativePath, ItemVersion::NormalVersion, delta);
+    }
+    for (auto it = fileStates.constBegin(); it != fileStates.constEnd(); ++it)
+        setFileState(it.key(), it.value(), delta);
+}
+
+int GitDirectoryStateTree::movePath(const QString &from, const QString &to, Global::VersionDelta *delta)
+{
+    if (from.isEmpty() || to.isEmpty() || from == to)
+        return 0;
+
+    QStringList sources;
+    if (fileState(from) != ItemVersion::NormalVersion)
+        sources.append(from);
+    const int node { findNode(from) };
+    if (node > 0)
+        collectFiles(node, &sources);
+
+    // 目标处原有的记录已不再对应磁盘上的文件
+    QStringList replaced;
+    if (fileState(to) != ItemVersion::NormalVersion)
+        replaced.append(to);
+    const int target { findNode(to) };
+    if (target > 0)
+        collectFiles(target, &replaced);
+
+    // 先取出状态再清除，清除时会回收空节点
+    QVector<QPair<QString, ItemVersion>> moved;
+    moved.reserve(sources.size());
+    for (const QString &source : std::as_const(sources))
+        moved.append(qMakePair(to + source.mid(from.size()), fileState(source)));
+
+    for (const QString &path : std::as_const(replaced))
+        setFileState(path, ItemVersion::NormalVersion, delta);
+    for (const QString &source : std::as_const(sources))
+        setFileState(source, ItemVersion::NormalVersion, delta);
+    for (const auto &entry : std::as_const(moved))
+        setFileState(entry.first, entry.second, delta);
+    return moved.size();
+}
+
+ItemVersion GitDirectoryStateTree::fileState(const QString &relativePath) const
+{
+    const int slash { relativePath.lastIndexOf(QLatin1Char('/')) };
+    const int node { findNode(slash < 0 ? QString() : relativePath.left(slash)) };
+    if (node < 0)
+        return ItemVersion::NormalVersion;
+    return m_nodes[node].files.value(relativePath.mid(slash + 1), ItemVersion::NormalVersion);
+}
+
+ItemVersion GitDirectoryStateTree::directoryState(const QString &relativePath) const
+{
+    const int node { findNode(relativePath) };
+    if (node < 0)
+        return ItemVersion::NormalVersion;
+    return deriveState(m_nodes[node], node == 0);
+}
+
+QHash<QString, ItemVersion> GitDirectoryStateTree::toVersionHash() const
+{
+    QHash<QString, ItemVersion> result;
+    result.reserve(m_fileCount + static_cast<int>(m_nodes.size()));
+
+    // 仓库根目录总是有记录，便于识别干净仓库
+    result.insert(m_repositoryPath, deriveState(m_nodes[0], true));
+    for (std::size_t i = 0; i < m_nodes.size(); ++i) {
+        const Node &node { m_nodes[i] };
+        if (i > 0 && node.parent < 0)   // 已回收的节点
+            continue;
+        if (i > 0) {
+            const ItemVersion state { deriveState(node, false) };
+            if (state != ItemVersion::NormalVersion)
+                result.insert(absolutePath(node.path), state);
+        }
+        for (auto it = node.files.constBegin(); it != node.files.constEnd(); ++it)
+            result.insert(absolutePath(joinPath(node.path, it.key())), it.value());
+    }
+    return result;
+}
+
+ItemVersion GitDirectoryStateTree::deriveState(const Node &node, bool isRoot)
+{
+    for (const PriorityRule &rule : kDirectoryPriority) {
+        if (isRoot && !rule.affectsRoot)
+            continue;
+        if (node.counts[static_cast<int>(rule.state)] > 0)
+            return rule.state;
+    }
+    return ItemVersion::NormalVersion;
+}
+
+int GitDirectoryStateTree::findNode(const QString &relativeDir) const
+{
+    int node { 0 };
+    int start { 0 };
+    while (node >= 0 && start < relativeDir.size()) {
+        int end { relativeDir.indexOf(QLatin1Char('/'), start) };
+        if (end < 0)
+            end = relativeDir.size();
+        node = m_nodes[node].children.value(relativeDir.mid(start, end - start), -1);
+        start = end + 1;
+    }
+    return node;
+}
+
+int GitDirectoryStateTree::ensureNode(const QString &relativeDir)
+{
+    int node { 0 };
+    int start { 0 };
+    while (start < relativeDir.size()) {
+        int end { relativeDir.indexOf(QLatin1Char('/'), start) };
+        if (end < 0)
+            end = relativeDir.size();
+        const QString &name { relativeDir.mid(start, end - start) };
+        int child { m_nodes[node].children.value(name, -1) };
+        if (child < 0) {
+            if (!m_freeNodes.empty()) {
+                child = m_freeNodes.back();
+                m_freeNodes.pop_back();
+            } else {
+                child = static_cast<int>(m_nodes.size());
+                m_nodes.emplace_back();
+            }
+            Node &created { m_nodes[child] };
+            created = Node();
+            created.path = relativeDir.left(end);
+            created.parent = node;
+            m_nodes[node].children.insert(name, child);
+        }
+        node = child;
+        start = end + 1;
+    }
+    return node;
+}
+
+void GitDirectoryStateTree::pruneNode(int node)
+{
+    // 回收不再包含任何记录的目录节点，根节点始终保留
+    while (node > 0 && m_nodes[node].files.isEmpty() && m_nodes[node].children.isEmpty()) {
+        Node &current { m_nodes[node] };
+        const int parent { current.parent };
+        const int slash { current.path.lastIndexOf(QLatin1Char('/')) };
+        m_nodes[parent].children.remove(current.path.mid(slash + 1));
+        current = Node();
+        m_freeNodes.push_back(node);
+        node = parent;
+    }
+}
+
+void GitDirectoryStateTree::collectFiles(int node, QStringList *files) const
+{
+    std::vector<int> pending { node };
+    while (!pending.empty()) {
+        const Node &current { m_nodes[pending.back()] };
+        pending.pop_back();
+        for (auto it = current.files.constBegin(); it != current.files.constEnd(); ++it)
+            files->append(joinPath(current.path, it.key()));
+        for (int child : current.children)
+            pending.push_back(child);
+    }
+}
+
+void GitDirectoryStateTree::recordChange(const QString &relativePath, ItemVersion state, bool isRoot,
+                                         Global::VersionDelta *delta) const
+{
+    const QString &path { isRoot ? m_repositoryPath : absolutePath(relativePath) };
+    if (state == ItemVersion::NormalVersion && !isRoot) {
+        delta->changed.remove(path);
+        delta->removed.insert(path);
+    } else {
+        delta->removed.remove(path);
+        delta->changed.insert(path, state);
+    }
+}
+
+QString GitDirectoryStateTree::absolutePath(const QString &relativePath) const
+{
+    return relativePath.isEmpty() ? m_repositoryPath : m_repositoryPath + QLatin1Char('/') + relativePath;
+}
@@ -0,0 +1,109 @@
+#ifndef GITDIRECTORYSTATETREE_H
+#define GITDIRECTORYSTATETREE_H
+
+#include <array>
+#include <vector>
+
+#include <QHash>
+#include <QString>
+
+#include <global.h>
+#include <repositorysnapshot.h>
+
+/**
+ * @brief 仓库目录状态聚合树
+ *
+ * 树中每个目录节点记录其子树内各状态文件的计数，目录状态由计数按优先级表推导。
+ * 单个文件状态变化时只需沿祖先链更新计数，代价为 O(depth)，
+ * 且变化的文件和目录状态直接写入增量，供缓存按变化量更新。
+ *
+ * 文件路径均为相对仓库根目录的路径；树只在状态检索线程中使用，不是线程安全的。
+ */
+class GitDirectoryStateTree
+{
+public:
+    /** 尚未向缓存发布过任何结果时的代数 */
+    static constexpr quint64 UNPUBLISHED_GENERATION = ~quint64(0);
+
+    explicit GitDirectoryStateTree(const QString &repositoryPath);
+
+    const QString &repositoryPath() const { return m_repositoryPath; }
+
+    /**
+     * @brief 已发布到缓存的快照代数，用于判断树与缓存是否同步
+     */
+    quint64 generation() const { return m_generation; }
+    void setGeneration(quint64 generation) { m_generation = generation; }
+
+    /**
+     * @brief 设置单个文件的状态，NormalVersion 表示文件不再有记录
+     * @param relativePath 相对仓库根目录的文件路径
+     * @param state 新状态
+     * @param delta 输出：变化的文件及目录状态
+     */
+    void setFileState(const QString &relativePath, Global::ItemVersion state, Global::VersionDelta *delta);
+
+    /**
+     * @brief 用一次完整检索的结果替换所有文件状态
+     * @param fileStates 相对路径 -> 状态（只含非 NormalVersion 的文件）
+     * @param delta 输出：变化的文件及目录状态
+     */
+    void replaceAll(const QHash<QString, Global::ItemVersion> &fileStates, Global::VersionDelta *delta);
+
+    /**
+     * @brief 用一次按路径限定的检索结果替换这些路径下的文件状态，范围外的记录保持不变
+     * @param scope 检索时使用的相对路径（文件或目录）
+     * @param fileStates 相对路径 -> 状态（只含 scope 内非 NormalVersion 的文件）
+     * @param delta 输出：变化的文件及目录状态
+     */
+    void replaceWithin(const QStringList &scope, const QHash<QString, Global::ItemVersion> &fileStates,
+                       Global::VersionDelta *delta);
+
+    /**
+     * @brief 把文件或目录子树的记录迁移到新路径，目标路径原有的记录被覆盖
+     * @param from 原相对路径
+     * @param to 新相对路径
+     * @param delta 输出：变化的文件及目录状态
+     * @return 迁移的文件记录数
+     */
+    int movePath(const QString &from, const QString &to, Global::VersionDelta *delta);
+
+    Global::ItemVersion fileState(const QString &relativePath) const;
+    Global::ItemVersion directoryState(const QString &relativePath) const;
+
+    /**
+     * @brief 导出完整的绝对路径 -> 状态表（文件、目录及仓库根目录）
+     */
+    QHash<QString, Global::ItemVersion> toVersionHash() const;
+
+    int fileCount() const { return m_fileCount; }
+
+private:
+    static constexpr int STATE_COUNT = static_cast<int>(Global::ItemVersion::MissingVersion) + 1;
+
+    struct Node
+    {
+        QString path;   // 相对路径，根节点为空
+        int parent { -1 };
+        QHash<QString, int> children;   // 子目录名 -> 节点下标
+        QHash<QString, Global::ItemVersion> files;   // 直接包含的文件名 -> 状态
+        std::array<int, STATE_COUNT> counts {};   // 子树内按目录贡献状态统计的文件数
+    };
+
+    static Global::ItemVersion deriveState(const Node &node, bool isRoot);
+    int findNode(const QString &relativeDir) const;
+    int ensureNode(const QString &relativeDir);
+    void pruneNode(int node);
+    void collectFiles(int node, QStringList *files) const;
+    void recordChange(const QString &relativePath, Global::ItemVersion state, bool isRoot,
+                      Global::VersionDelta *delta) const;
+    QString absolutePath(const QString &relativePath) const;
+
+    QString m_repositoryPath;
+    quint64 m_generation { UNPUBLISHED_GENERATION };
+    std::vector<Node> m_nodes;
+    std::vector<int> m_freeNodes;
+    int m_fileCount { 0 };
+};
+
+#endif   // GITDIRECTORYSTATETREE_H
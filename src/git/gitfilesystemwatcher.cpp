@@ -1,35 +1,112 @@
 #include "gitfilesystemwatcher.h"
 #include "utils.h"
+#include "gitignorematcher.h"
+#include "gitrepositoryresolver.h"
+#include "gitrepositoryinfo.h"
+#include "gitinotifywatcher.h"
 
 #include <QDir>
 #include <QFileInfo>
 #include <QDebug>
 #include <QProcess>
 #include <QCoreApplication>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QDateTime>
+
+#include <limits>
+
+// 在线程池中计算仓库的监控列表，结果投递回界面线程
+class GitWatchSetupJob : public QRunnable
+{
+public:
+    GitWatchSetupJob(GitFileSystemWatcher *watcher, const QString &repositoryPath, quint64 serial, int limit)
+        : m_watcher(watcher), m_repositoryPath(repositoryPath), m_serial(serial), m_limit(limit)
+    {
+    }
+
+    void run() override
+    {
+        const GitFileSystemWatcher::WatchSet &watchSet { GitFileSystemWatcher::computeWatchSet(m_repositoryPath, m_limit) };
+        QMetaObject::invokeMethod(m_watcher, [watcher = m_watcher, repositoryPath = m_repositoryPath,
+                                              serial = m_serial, watchSet]() {
+            watcher->onWatchSetReady(repositoryPath, serial, watchSet);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    GitFileSystemWatcher *m_watcher { nullptr };
+    QString m_repositoryPath;
+    quint64 m_serial { 0 };
+    int m_limit { 0 };
+};
+
+int GitFileSystemWatcher::classifyMetadata(const QString &name)
+{
+    static const QHash<QString, int> kinds = {
+        { "index", IndexChange },
+        { "MERGE_HEAD", IndexChange },
+        { "CHERRY_PICK_HEAD", IndexChange },
+        { "REVERT_HEAD", IndexChange },
+        { "rebase-merge", IndexChange },
+        { "rebase-apply", IndexChange },
+        { "HEAD", RefChange },
+        { "ORIG_HEAD", RefChange },
+        { "packed-refs", RefChange | FetchChange },
+        { "FETCH_HEAD", FetchChange },
+        { "config", ConfigChange }
+    };
+    return kinds.value(name, 0);
+}
 
 GitFileSystemWatcher::GitFileSystemWatcher(QObject *parent)
     : QObject(parent),
       m_fileWatcher(new QFileSystemWatcher(this)),
       m_updateTimer(new QTimer(this)),
-      m_cleanupTimer(new QTimer(this))
+      m_holdTimer(new QTimer(this)),
+      m_setupPool(new QThreadPool(this))
 {
     qInfo() << "INFO: [GitFileSystemWatcher] Initializing real-time Git file system monitor";
 
-    // 配置防抖更新定时器
+    // 监控列表的计算逐个仓库进行，不与状态检索争抢 CPU
+    m_setupPool->setMaxThreadCount(1);
+
+    // 防抖定时器按最早到期的仓库启动
     m_updateTimer->setSingleShot(true);
-    m_updateTimer->setInterval(UPDATE_DELAY_MS);
     connect(m_updateTimer, &QTimer::timeout, this, &GitFileSystemWatcher::onDelayedUpdate);
 
+    // git 操作进行中被挂起的更新定期检查一次
+    m_holdTimer->setInterval(HOLD_POLL_INTERVAL_MS);
+    connect(m_holdTimer, &QTimer::timeout, this, &GitFileSystemWatcher::onHoldTimeout);
+
     // 配置文件系统监控器信号
     connect(m_fileWatcher, &QFileSystemWatcher::fileChanged,
             this, &GitFileSystemWatcher::onFileChanged);
     connect(m_fileWatcher, &QFileSystemWatcher::directoryChanged,
             this, &GitFileSystemWatcher::onDirectoryChanged);
 
-    // 配置定期清理定时器
-    m_cleanupTimer->setInterval(CLEANUP_INTERVAL_MS);
-    connect(m_cleanupTimer, &QTimer::timeout, this, &GitFileSystemWatcher::onCleanupPaths);
-    m_cleanupTimer->start();
+    // 优先使用 inotify 后端，事件读取与目录遍历都在独立线程中进行
+    auto inotifyWatcher { new GitInotifyWatcher };
+    if (inotifyWatcher->isValid()) {
+        m_inotifyWatcher = inotifyWatcher;
+        m_inotifyThread = new QThread(this);
+        m_inotifyThread->setObjectName("GitInotifyWatcher");
+        m_inotifyWatcher->moveToThread(m_inotifyThread);
+        connect(m_inotifyThread, &QThread::started, m_inotifyWatcher, &GitInotifyWatcher::initialize);
+        connect(m_inotifyThread, &QThread::finished, m_inotifyWatcher, &QObject::deleteLater);
+        connect(m_inotifyWatcher, &GitInotifyWatcher::repositoryChanged,
+                this, &GitFileSystemWatcher::onInotifyRepositoryChanged, Qt::QueuedConnection);
+        connect(m_inotifyWatcher, &GitInotifyWatcher::repositoryWatchUsage,
+                this, &GitFileSystemWatcher::onInotifyWatchUsage, Qt::QueuedConnection);
+        connect(m_inotifyWatcher, &GitInotifyWatcher::pathsMoved,
+                this, &GitFileSystemWatcher::onInotifyPathsMoved, Qt::QueuedConnection);
+        m_inotifyThread->start();
+        qInfo() << "INFO: [GitFileSystemWatcher] Using inotify backend";
+    } else {
+        delete inotifyWatcher;
+        qInfo() << "INFO: [GitFileSystemWatcher] Falling back to QFileSystemWatcher";
+    }
 
     qInfo() << "INFO: [GitFileSystemWatcher] File system monitor initialized successfully";
 }
@@ -40,7 +117,18 @@ GitFileSystemWatcher::~GitFileSystemWatcher()
 
     // 停止定时器
     m_updateTimer->stop();
-    m_cleanupTimer->stop();
+    m_holdTimer->stop();
+
+    // 等待后台任务结束，之后投递过来的结果随对象一起丢弃
+    m_setupPool->clear();
+    m_setupPool->waitForDone();
+
+    // finished 时 inotify 后端随之销毁
+    if (m_inotifyThread) {
+        m_inotifyThread->quit();
+        m_inotifyThread->wait();
+        m_inotifyWatcher = nullptr;
+    }
 
     // 清理所有监控
     for (const QString &repo : m_repositories) {
@@ -49,9 +137,12 @@ GitFileSystemWatcher::~GitFileSystemWatcher()
 
     // 清理缓存
     m_repositories.clear();
+    m_repositoryIndex.clear();
     m_pendingUpdates.clear();
+    m_debounces.clear();
     m_repoFiles.clear();
     m_repoDirs.clear();
+    m_metadataPaths.clear();
 }
 
 void GitFileSystemWatcher::addRepository(const QString &repositoryPath)
@@ -69,7 +160,15 @@ void GitFileSystemWatcher::addRepository(const QString &repositoryPath)
     qInfo() << "INFO: [GitFileSystemWatcher] Adding repository to monitor:" << repositoryPath;
 
     m_repositories.insert(repositoryPath);
-    setupRepositoryWatching(repositoryPath);
+    m_repositoryIndex.insert(repositoryPath);
+    m_budget.addRepository(repositoryPath);
+
+    // 先只监控元数据，工作区按重新分配后的配额监控
+    m_watchLevels.insert(repositoryPath, GitWatchBudget::Level::MetadataOnly);
+    if (m_inotifyWatcher)
+        QMetaObject::invokeMethod(m_inotifyWatcher, "addRepository", Qt::QueuedConnection,
+                                  Q_ARG(QString, repositoryPath), Q_ARG(int, 0));
+    rebalanceWatches();
 
     qInfo() << "INFO: [GitFileSystemWatcher] Successfully added repository:" << repositoryPath
             << "Total repositories:" << m_repositories.size();
@@ -84,10 +183,20 @@ void GitFileSystemWatcher::removeRepository(const QString &repositoryPath)
     qInfo() << "INFO: [GitFileSystemWatcher] Removing repository from monitor:" << repositoryPath;
 
     removeRepositoryWatching(repositoryPath);
+    GitRepositoryResolver::instance().invalidate(repositoryPath);
+    GitRepositoryInfoStore::instance().remove(repositoryPath);
     m_repositories.remove(repositoryPath);
+    m_repositoryIndex.remove(repositoryPath);
     m_pendingUpdates.remove(repositoryPath);
+    m_debounces.remove(repositoryPath);
+    m_statusCosts.remove(repositoryPath);
+    m_heldUpdates.remove(repositoryPath);
+    m_dirtyRepositories.remove(repositoryPath);
     m_repoFiles.remove(repositoryPath);
     m_repoDirs.remove(repositoryPath);
+    m_watchLevels.remove(repositoryPath);
+    m_budget.removeRepository(repositoryPath);
+    rebalanceWatches();
 
     qInfo() << "INFO: [GitFileSystemWatcher] Successfully removed repository:" << repositoryPath
             << "Remaining repositories:" << m_repositories.size();
@@ -103,29 +212,96 @@ bool GitFileSystemWatcher::isWatching(const QString &repositoryPath) const
     return m_repositories.contains(repositoryPath);
 }
 
+void GitFileSystemWatcher::setVisibleRepositories(const QSet<QString> &repositories)
+{
+    m_budget.setVisibleRepositories(repositories);
+    rebalanceWatches();
+}
+
+GitWatchBudget::Allocation GitFileSystemWatcher::watchAllocation(const QString &repositoryPath) const
+{
+    return m_budget.allocation(repositoryPath);
+}
+
+bool GitFileSystemWatcher::takeDirty(const QString &repositoryPath)
+{
+    return m_dirtyRepositories.remove(repositoryPath);
+}
+
 void GitFileSystemWatcher::onFileChanged(const QString &path)
 {
+    if (scheduleMetadataUpdate(path))
+        return;
+
     QString repositoryPath = getRepositoryFromPath(path);
     if (repositoryPath.isEmpty()) {
         return;
     }
 
-    if (!shouldWatchFile(path)) {
+    qInfo() << "INFO: [GitFileSystemWatcher] File changed:" << path << "in repository:" << repositoryPath;
+    if (!QFileInfo::exists(path))
+        forgetWatchedPath(repositoryPath, path);
+    else if (m_repoFiles.value(repositoryPath).contains(path))
+        m_fileWatcher->addPath(path);   // 以改名方式保存的文件是新的 inode，重新监控（仍在监控时不做任何事）
+
+    // 忽略规则变化影响所在目录下的所有路径
+    if (path.endsWith("/.gitignore")) {
+        GitIgnoreMatcher::instance().invalidate(path);
+        scheduleUpdate(repositoryPath, WorkTreeChange, QFileInfo(path).absolutePath());
         return;
     }
+    scheduleUpdate(repositoryPath, WorkTreeChange, path);
+}
 
-    qInfo() << "INFO: [GitFileSystemWatcher] File changed:" << path << "in repository:" << repositoryPath;
-    scheduleUpdate(repositoryPath);
+void GitFileSystemWatcher::onInotifyRepositoryChanged(const QString &repositoryPath, int changes, const QStringList &paths)
+{
+    // 解析器缓存已由 inotify 后端按目录失效
+    qDebug() << "[GitFileSystemWatcher] inotify reported change in repository:" << repositoryPath
+             << "changes:" << changes << "paths:" << paths.size();
+    if (paths.isEmpty()) {
+        scheduleUpdate(repositoryPath, changes);
+        return;
+    }
+    for (const QString &path : paths)
+        scheduleUpdate(repositoryPath, changes, path);
+}
+
+void GitFileSystemWatcher::onInotifyWatchUsage(const QString &repositoryPath, int used, bool complete)
+{
+    if (!m_repositories.contains(repositoryPath))
+        return;
+    m_budget.reportUsage(repositoryPath, used, complete);
+    rebalanceWatches();
+}
+
+void GitFileSystemWatcher::onInotifyPathsMoved(const QString &repositoryPath, const QStringList &sources,
+                                               const QStringList &targets)
+{
+    if (!m_repositories.contains(repositoryPath))
+        return;
+    // 改名不经过防抖，缓存立即迁移；两端路径随 repositoryChanged 按常规防抖后检索确认
+    qDebug() << "[GitFileSystemWatcher] inotify reported" << sources.size() << "moves in repository:" << repositoryPath;
+    emit repositoryPathsMoved(repositoryPath, sources, targets);
 }
 
 void GitFileSystemWatcher::onDirectoryChanged(const QString &path)
 {
+    if (scheduleMetadataUpdate(path))
+        return;
+
     QString repositoryPath = getRepositoryFromPath(path);
     if (repositoryPath.isEmpty()) {
         return;
     }
 
     qInfo() << "INFO: [GitFileSystemWatcher] Directory changed:" << path << "in repository:" << repositoryPath;
+    if (!QFileInfo::exists(path))
+        forgetWatchedPath(repositoryPath, path);
+
+    // 目录下可能新建或删除了 .git（git init、clone、submodule），仓库根目录的解析结果随之失效
+    GitRepositoryResolver::instance().invalidate(path);
+    // 新建的 .gitignore 尚未被跟踪，只能通过所在目录的变化发现
+    GitIgnoreMatcher::instance().invalidate(path + "/.gitignore");
 
     // 目录变化可能意味着：
     // 1. 新建了文件（untracked状态）
@@ -136,179 +312,381 @@ void GitFileSystemWatcher::onDirectoryChanged(const QString &path)
     // 关键修复：检测并添加新建的子目录到监控
     checkAndAddNewDirectories(path, repositoryPath);
 
-    // 需要立即更新整个仓库状态
-    scheduleUpdate(repositoryPath);
+    // 目录下的增删只影响该目录
+    scheduleUpdate(repositoryPath, WorkTreeChange, path);
+}
+
+void GitFileSystemWatcher::setStatusCost(const QString &repositoryPath, qint64 cost)
+{
+    if (m_repositories.contains(repositoryPath))
+        m_statusCosts.insert(repositoryPath, cost);
 }
 
 void GitFileSystemWatcher::onDelayedUpdate()
 {
-    QSet<QString> repositoriesToUpdate = m_pendingUpdates;
-    m_pendingUpdates.clear();
+    const qint64 now { QDateTime::currentMSecsSinceEpoch() };
+    QHash<QString, PendingChange> dueUpdates;
+    for (auto it = m_pendingUpdates.begin(); it != m_pendingUpdates.end();) {
+        if (m_debounces.value(it.key()).deadline > now) {
+            ++it;
+            continue;
+        }
+        dueUpdates.insert(it.key(), it.value());
+        it = m_pendingUpdates.erase(it);
+    }
 
-    for (const QString &repositoryPath : repositoriesToUpdate) {
-        qInfo() << "INFO: [GitFileSystemWatcher] Emitting repository changed signal for:" << repositoryPath;
-        emit repositoryChanged(repositoryPath);
+    for (auto it = dueUpdates.cbegin(); it != dueUpdates.cend(); ++it) {
+        if (holdUpdate(it.key(), it.value()))
+            continue;
+        qInfo() << "INFO: [GitFileSystemWatcher] Emitting repository changed signal for:" << it.key()
+                << "changes:" << it->changes << (it->fullWorkTree ? "full work tree" : "paths:") << it->paths.size();
+        emit repositoryChanged(it.key(), it->changes, it->fullWorkTree ? QStringList() : it->paths.values());
     }
+
+    armUpdateTimer();
 }
 
-void GitFileSystemWatcher::onCleanupPaths()
+void GitFileSystemWatcher::armUpdateTimer()
 {
-    qDebug() << "[GitFileSystemWatcher] Running periodic cleanup of invalid paths";
+    if (m_pendingUpdates.isEmpty()) {
+        m_updateTimer->stop();
+        return;
+    }
 
-    // 清理无效的文件路径
-    QStringList currentFiles = m_fileWatcher->files();
-    QStringList invalidFiles;
+    qint64 deadline { std::numeric_limits<qint64>::max() };
+    for (auto it = m_pendingUpdates.cbegin(); it != m_pendingUpdates.cend(); ++it)
+        deadline = qMin(deadline, m_debounces.value(it.key()).deadline);
+    const qint64 delay { qMax<qint64>(0, deadline - QDateTime::currentMSecsSinceEpoch()) };
+    m_updateTimer->start(static_cast<int>(delay));
+}
 
-    for (const QString &filePath : currentFiles) {
-        if (!QFileInfo::exists(filePath)) {
-            invalidFiles.append(filePath);
+void GitFileSystemWatcher::debounce(const QString &repositoryPath, bool alreadyPending)
+{
+    // 窗口按该仓库完整检索的耗时调整：检索越慢，合并得越多，但最长等待时间内必定发出一次
+    const qint64 cost { m_statusCosts.value(repositoryPath, DEFAULT_STATUS_COST_MS) };
+    const qint64 baseWindow { qBound(MIN_DEBOUNCE_MS, cost, MAX_BASE_DEBOUNCE_MS) };
+    const qint64 maxWindow { qBound(MIN_MAX_DEBOUNCE_MS, cost * DEBOUNCE_COST_FACTOR, MAX_DEBOUNCE_MS) };
+    const qint64 maxWait { qBound(MIN_MAX_WAIT_MS, cost * MAX_WAIT_COST_FACTOR, MAX_MAX_WAIT_MS) };
+
+    const qint64 now { QDateTime::currentMSecsSinceEpoch() };
+    Debounce &state { m_debounces[repositoryPath] };
+    if (!alreadyPending) {
+        state.pendingSince = now;
+        if (now - state.lastEvent > state.window) {
+            // 孤立的事件立即刷新，同一轮事件循环中到达的事件仍会合并
+            state.window = baseWindow;
+            state.deadline = now;
+        } else {
+            // 刚发出更新又有事件：负载持续，窗口加倍
+            state.window = qMin(qMax(state.window, baseWindow) * 2, maxWindow);
+            state.deadline = now + state.window;
         }
+    } else if (state.deadline > state.pendingSince) {
+        // 事件持续到达时顺延，但不超过最长等待时间
+        state.deadline = qMin(now + state.window, state.pendingSince + maxWait);
     }
+    state.lastEvent = now;
+}
 
-    if (!invalidFiles.isEmpty()) {
-        m_fileWatcher->removePaths(invalidFiles);
-        qDebug() << "[GitFileSystemWatcher] Cleaned up" << invalidFiles.size() << "invalid file paths";
+void GitFileSystemWatcher::onHoldTimeout()
+{
+    const qint64 now { QDateTime::currentMSecsSinceEpoch() };
+    for (auto it = m_heldUpdates.begin(); it != m_heldUpdates.end();) {
+        const QString &repositoryPath { it.key() };
+        const bool timedOut { now - it->second >= MAX_HOLD_MS };
+        if (!timedOut && isOperationInProgress(repositoryPath)) {
+            ++it;
+            continue;
+        }
+
+        // 操作期间的所有事件合并为一次更新
+        const PendingChange change { it->first };
+        it = m_heldUpdates.erase(it);
+        qInfo() << "INFO: [GitFileSystemWatcher] Releasing held update for:" << repositoryPath
+                << (timedOut ? "(max wait reached)" : "(operation finished)");
+        emit repositoryChanged(repositoryPath, change.changes, change.fullWorkTree ? QStringList() : change.paths.values());
     }
 
-    // 清理无效的目录路径
-    QStringList currentDirs = m_fileWatcher->directories();
-    QStringList invalidDirs;
+    if (m_heldUpdates.isEmpty())
+        m_holdTimer->stop();
+}
 
-    for (const QString &dirPath : currentDirs) {
-        if (!QDir(dirPath).exists()) {
-            invalidDirs.append(dirPath);
-        }
+bool GitFileSystemWatcher::holdUpdate(const QString &repositoryPath, const PendingChange &change)
+{
+    auto held = m_heldUpdates.find(repositoryPath);
+    if (held == m_heldUpdates.end()) {
+        if (!isOperationInProgress(repositoryPath))
+            return false;
+        qDebug() << "[GitFileSystemWatcher] Git operation in progress, holding updates for:" << repositoryPath;
+        held = m_heldUpdates.insert(repositoryPath, qMakePair(PendingChange(), QDateTime::currentMSecsSinceEpoch()));
     }
 
-    if (!invalidDirs.isEmpty()) {
-        m_fileWatcher->removePaths(invalidDirs);
-        qDebug() << "[GitFileSystemWatcher] Cleaned up" << invalidDirs.size() << "invalid directory paths";
+    // 已挂起的仓库继续累积，由 onHoldTimeout() 统一发出
+    mergeChange(&held->first, change);
+    if (!m_holdTimer->isActive())
+        m_holdTimer->start();
+    return true;
+}
+
+bool GitFileSystemWatcher::isOperationInProgress(const QString &repositoryPath)
+{
+    const QString &gitDir { Utils::gitDirectory(repositoryPath) };
+    if (gitDir.isEmpty())
+        return false;
+
+    // index.lock 存在期间 git 正在写入 index 与工作区；rebase、merge 进行中会反复改写
+    static const QStringList markers { "/index.lock", "/rebase-merge", "/rebase-apply", "/MERGE_HEAD" };
+    for (const QString &marker : markers) {
+        if (QFileInfo::exists(gitDir + marker))
+            return true;
     }
+    return false;
+}
 
-    // 更新缓存
-    for (auto it = m_repoFiles.begin(); it != m_repoFiles.end(); ++it) {
-        QStringList &files = it.value();
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-        files.removeIf([](const QString &path) {
-            return !QFileInfo::exists(path);
-        });
-#else
-        for (int i = files.size() - 1; i >= 0; --i) {
-            if (!QFileInfo::exists(files.at(i))) {
-                files.removeAt(i);
-            }
-        }
-#endif
+void GitFileSystemWatcher::mergeChange(PendingChange *target, const PendingChange &change)
+{
+    target->changes |= change.changes;
+    if (change.fullWorkTree || target->fullWorkTree || target->paths.size() + change.paths.size() > MAX_PENDING_PATHS) {
+        target->fullWorkTree = true;
+        target->paths.clear();
+        return;
     }
+    target->paths.unite(change.paths);
+}
 
-    for (auto it = m_repoDirs.begin(); it != m_repoDirs.end(); ++it) {
-        QStringList &dirs = it.value();
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-        dirs.removeIf([](const QString &path) {
-            return !QDir(path).exists();
-        });
-#else
-        for (int i = dirs.size() - 1; i >= 0; --i) {
-            if (!QDir(dirs.at(i)).exists()) {
-                dirs.removeAt(i);
-            }
-        }
-#endif
+void GitFileSystemWatcher::forgetWatchedPath(const QString &repositoryPath, const QString &path)
+{
+    // 删除、移走或所在文件系统被卸载时 QFileSystemWatcher 会发出一次变化并停止监控该路径，
+    // 每个被监控的子路径各自收到通知，这里只需移除路径本身
+    auto files = m_repoFiles.find(repositoryPath);
+    const bool removedFile { files != m_repoFiles.end() && files->remove(path) };
+    auto dirs = m_repoDirs.find(repositoryPath);
+    const bool removedDir { dirs != m_repoDirs.end() && dirs->remove(path) };
+    if (removedFile || removedDir)
+        qDebug() << "[GitFileSystemWatcher] Stopped watching removed path:" << path;
+
+    auto owners = m_metadataPaths.find(path);
+    if (owners != m_metadataPaths.end()) {
+        owners->remove(repositoryPath);
+        if (owners->isEmpty())
+            m_metadataPaths.erase(owners);
     }
 }
 
+bool GitFileSystemWatcher::scheduleMetadataUpdate(const QString &path)
+{
+    const QHash<QString, int> owners { m_metadataPaths.value(path) };
+    if (owners.isEmpty())
+        return false;
+
+    const bool exists { QFileInfo::exists(path) };
+    for (auto it = owners.constBegin(); it != owners.constEnd(); ++it) {
+        const QString &repositoryPath { it.key() };
+        qDebug() << "[GitFileSystemWatcher] Git metadata changed:" << path << "in repository:" << repositoryPath;
+        if (!exists)
+            forgetWatchedPath(repositoryPath, path);
+        else if (m_repoFiles.value(repositoryPath).contains(path))
+            m_fileWatcher->addPath(path);   // index、HEAD 等以 "写 .lock 再改名" 的方式更新，重新监控新的 inode
+        // COMMIT_EDITMSG 等与状态无关的元数据不触发刷新
+        if (it.value())
+            scheduleUpdate(repositoryPath, it.value());
+    }
+    return true;
+}
+
 void GitFileSystemWatcher::setupRepositoryWatching(const QString &repositoryPath)
 {
     qInfo() << "INFO: [GitFileSystemWatcher] Setting up monitoring for repository:" << repositoryPath;
 
-    QStringList allPaths;
+    // git ls-files 与逐个文件的检查在线程池中进行，完成后回到界面线程分批添加
+    const quint64 serial { ++m_lastSetupSerial };
+    m_setupSerials.insert(repositoryPath, serial);
+    m_setupPool->start(new GitWatchSetupJob(this, repositoryPath, serial, watchLimit(repositoryPath)));
+}
 
-    // 1. 添加Git元数据文件监控
-    QStringList gitFiles = getGitMetadataFiles(repositoryPath);
-    allPaths.append(gitFiles);
-    qDebug() << "[GitFileSystemWatcher] Found" << gitFiles.size() << "Git metadata files";
+void GitFileSystemWatcher::rebalanceWatches()
+{
+    const QStringList &changed { m_budget.rebalance() };
+    for (const QString &repositoryPath : changed)
+        applyAllocation(repositoryPath);
+}
+
+void GitFileSystemWatcher::applyAllocation(const QString &repositoryPath)
+{
+    const GitWatchBudget::Allocation &allocation { m_budget.allocation(repositoryPath) };
+    const GitWatchBudget::Level previous { m_watchLevels.value(repositoryPath, GitWatchBudget::Level::MetadataOnly) };
+    m_watchLevels.insert(repositoryPath, allocation.level);
+    qDebug() << "[GitFileSystemWatcher] Watch allocation of repository:" << repositoryPath
+             << "level:" << static_cast<int>(allocation.level) << "granted:" << allocation.granted
+             << "used:" << allocation.used << "visible:" << allocation.visible;
+
+    if (m_inotifyWatcher) {
+        QMetaObject::invokeMethod(m_inotifyWatcher, "setRepositoryLimit", Qt::QueuedConnection,
+                                  Q_ARG(QString, repositoryPath), Q_ARG(int, watchLimit(repositoryPath)));
+    } else if (allocation.level != previous || allocation.used > allocation.granted || allocation.used == 0
+               || !allocation.complete) {
+        // 级别不变且现有监控仍在配额内时无需重新计算
+        removeRepositoryWatching(repositoryPath);
+        m_repoFiles.remove(repositoryPath);
+        m_repoDirs.remove(repositoryPath);
+        setupRepositoryWatching(repositoryPath);
+    }
+
+    // 升级之前工作区的变化没有被完整监控，补一次检索
+    const bool promoted { (previous == GitWatchBudget::Level::MetadataOnly && allocation.level != previous)
+                          || (previous == GitWatchBudget::Level::Partial && allocation.level == GitWatchBudget::Level::Full) };
+    if (promoted && allocation.used > 0)
+        scheduleUpdate(repositoryPath, WorkTreeChange);
+}
 
-    // 2. 添加重要目录监控
-    QStringList importantDirs = getImportantDirectories(repositoryPath);
-    allPaths.append(importantDirs);
-    qDebug() << "[GitFileSystemWatcher] Found" << importantDirs.size() << "important directories";
+int GitFileSystemWatcher::watchLimit(const QString &repositoryPath) const
+{
+    const GitWatchBudget::Allocation &allocation { m_budget.allocation(repositoryPath) };
+    return allocation.level == GitWatchBudget::Level::MetadataOnly ? 0 : allocation.granted;
+}
 
-    // 3. 添加被跟踪文件监控（关键！）
-    QStringList trackedFiles = getTrackedFiles(repositoryPath);
-    allPaths.append(trackedFiles);
+GitFileSystemWatcher::WatchSet GitFileSystemWatcher::computeWatchSet(const QString &repositoryPath, int limit)
+{
+    WatchSet watchSet;
+
+    // 1. Git元数据文件与目录，worktree/submodule 的 git 目录不在 <repositoryPath>/.git
+    const QString &gitDir { Utils::gitDirectory(repositoryPath) };
+    if (!gitDir.isEmpty()) {
+        const QHash<QString, int> &metadataFiles { getGitMetadataFiles(gitDir) };
+        const QHash<QString, int> &metadataDirectories { getGitMetadataDirectories(gitDir) };
+        watchSet.files = metadataFiles.keys();
+        watchSet.directories = metadataDirectories.keys();
+        watchSet.metadata = metadataFiles;
+        for (auto it = metadataDirectories.constBegin(); it != metadataDirectories.constEnd(); ++it)
+            watchSet.metadata.insert(it.key(), it.value());
+    }
+    qDebug() << "[GitFileSystemWatcher] Found" << watchSet.metadata.size() << "Git metadata paths";
+
+    // 2. 重要目录，工作区目录最多占配额的一半
+    bool directoriesComplete { true };
+    watchSet.directories.append(getImportantDirectories(repositoryPath, limit / 2, &directoriesComplete));
+    qDebug() << "[GitFileSystemWatcher] Found" << watchSet.directories.size() << "important directories";
+    if (limit <= 0)
+        return watchSet;
+
+    // 3. 被跟踪文件（已检查存在且为普通文件）
+    bool filesComplete { true };
+    const int maxFiles { qMax(0, limit - static_cast<int>(watchSet.files.size() + watchSet.directories.size())) };
+    const QStringList &trackedFiles { getTrackedFiles(repositoryPath, maxFiles, &filesComplete) };
+    watchSet.files.append(trackedFiles);
+    watchSet.complete = directoriesComplete && filesComplete;
     qInfo() << "INFO: [GitFileSystemWatcher] Found" << trackedFiles.size()
             << "tracked files to monitor";
 
-    // 立即同步添加所有监控路径（关键修复！）
-    if (!allPaths.isEmpty()) {
-        // 过滤出有效路径
-        QStringList validPaths;
-        for (const QString &path : allPaths) {
-            if (QFileInfo::exists(path)) {
-                validPaths.append(path);
-            }
-        }
+    return watchSet;
+}
 
-        if (!validPaths.isEmpty()) {
-            // 同步添加所有路径 - 不使用异步以确保立即生效
-            m_fileWatcher->addPaths(validPaths);
-            qInfo() << "INFO: [GitFileSystemWatcher] Immediately added" << validPaths.size() << "paths to file watcher";
-        }
+void GitFileSystemWatcher::onWatchSetReady(const QString &repositoryPath, quint64 serial, const WatchSet &watchSet)
+{
+    // 期间仓库已被移除或重新设置
+    if (!m_repositories.contains(repositoryPath) || m_setupSerials.value(repositoryPath) != serial)
+        return;
+    m_setupSerials.remove(repositoryPath);
+
+    QSet<QString> &files { m_repoFiles[repositoryPath] };
+    files.clear();
+    files.reserve(watchSet.files.size());
+    for (const QString &file : watchSet.files)
+        files.insert(file);
+    QSet<QString> &directories { m_repoDirs[repositoryPath] };
+    directories.clear();
+    directories.reserve(watchSet.directories.size());
+    for (const QString &directory : watchSet.directories)
+        directories.insert(directory);
+    for (auto it = watchSet.metadata.constBegin(); it != watchSet.metadata.constEnd(); ++it)
+        m_metadataPaths[it.key()].insert(repositoryPath, it.value());
+    addWatchPaths(repositoryPath, watchSet.directories + watchSet.files);
+
+    qInfo() << "INFO: [GitFileSystemWatcher] Successfully setup monitoring for repository:" << repositoryPath
+            << "Files:" << watchSet.files.size() << "Directories:" << watchSet.directories.size();
+
+    // 只监控元数据时的用量对分配没有意义
+    if (watchLimit(repositoryPath) > 0) {
+        m_budget.reportUsage(repositoryPath, watchSet.files.size() + watchSet.directories.size(), watchSet.complete);
+        rebalanceWatches();
+    }
+}
 
-        // 分别缓存文件和目录
-        QStringList files, dirs;
-        for (const QString &path : allPaths) {
-            if (QFileInfo(path).isFile()) {
-                files.append(path);
-            } else if (QFileInfo(path).isDir()) {
-                dirs.append(path);
-            }
+void GitFileSystemWatcher::onApplyWatchBatch()
+{
+    // 每轮事件循环只添加一批，避免一次 addPaths 上千个路径阻塞界面
+    int budget { APPLY_BATCH_SIZE };
+    while (budget > 0 && !m_queuedWatches.isEmpty()) {
+        auto it = m_queuedWatches.begin();
+        QStringList &queued { it.value() };
+        const int count { qMin(budget, static_cast<int>(queued.size())) };
+        // 计算监控列表之后才被删除的路径添加失败，不会再有通知，直接移出监控集合
+        const QStringList &failed { m_fileWatcher->addPaths(queued.mid(0, count)) };
+        for (const QString &path : failed) {
+            if (!QFileInfo::exists(path))
+                forgetWatchedPath(it.key(), path);
         }
+        queued.erase(queued.begin(), queued.begin() + count);
+        budget -= count;
+        if (queued.isEmpty())
+            m_queuedWatches.erase(it);
+    }
 
-        m_repoFiles[repositoryPath] = files;
-        m_repoDirs[repositoryPath] = dirs;
-
-        qInfo() << "INFO: [GitFileSystemWatcher] Successfully setup monitoring for repository:" << repositoryPath
-                << "Files:" << files.size() << "Directories:" << dirs.size();
-
-        // 输出当前监控的路径数量用于调试
-        qInfo() << "INFO: [GitFileSystemWatcher] Total paths being watched:"
-                << "Files:" << m_fileWatcher->files().size()
-                << "Directories:" << m_fileWatcher->directories().size();
+    if (!m_queuedWatches.isEmpty()) {
+        QTimer::singleShot(0, this, &GitFileSystemWatcher::onApplyWatchBatch);
+        return;
     }
+
+    qInfo() << "INFO: [GitFileSystemWatcher] Total paths being watched:"
+            << "Files:" << m_fileWatcher->files().size()
+            << "Directories:" << m_fileWatcher->directories().size();
 }
 
 void GitFileSystemWatcher::removeRepositoryWatching(const QString &repositoryPath)
 {
     qDebug() << "[GitFileSystemWatcher] Removing monitoring for repository:" << repositoryPath;
 
-    // 移除文件监控
-    if (m_repoFiles.contains(repositoryPath)) {
-        QStringList files = m_repoFiles[repositoryPath];
-        if (!files.isEmpty()) {
-            m_fileWatcher->removePaths(files);
-        }
+    if (m_inotifyWatcher) {
+        QMetaObject::invokeMethod(m_inotifyWatcher, "removeRepository", Qt::QueuedConnection,
+                                  Q_ARG(QString, repositoryPath));
+        return;
     }
 
-    // 移除目录监控
-    if (m_repoDirs.contains(repositoryPath)) {
-        QStringList dirs = m_repoDirs[repositoryPath];
-        if (!dirs.isEmpty()) {
-            m_fileWatcher->removePaths(dirs);
+    // 尚未完成的设置与尚未添加的路径直接丢弃
+    m_setupSerials.remove(repositoryPath);
+    m_queuedWatches.remove(repositoryPath);
+
+    // worktree 共享的 commondir 仍被其他仓库监控时保留
+    QStringList paths;
+    const QSet<QString> &files { m_repoFiles.value(repositoryPath) };
+    const QSet<QString> &dirs { m_repoDirs.value(repositoryPath) };
+    paths.reserve(files.size() + dirs.size());
+    for (const QSet<QString> *watched : { &files, &dirs }) {
+        for (const QString &path : *watched) {
+            auto owners = m_metadataPaths.find(path);
+            if (owners != m_metadataPaths.end()) {
+                owners->remove(repositoryPath);
+                if (!owners->isEmpty())
+                    continue;
+                m_metadataPaths.erase(owners);
+            }
+            paths.append(path);
         }
     }
+    if (!paths.isEmpty())
+        m_fileWatcher->removePaths(paths);
 }
 
-QStringList GitFileSystemWatcher::getGitMetadataFiles(const QString &repositoryPath) const
+QHash<QString, int> GitFileSystemWatcher::getGitMetadataFiles(const QString &gitDir)
 {
-    QStringList files;
-    QString gitDir = repositoryPath + "/.git";
+    QHash<QString, int> files;
+    const QString &commonDir { Utils::gitCommonDirectory(gitDir) };
 
-    // Git关键元数据文件
-    QStringList gitFiles = {
+    // Git关键元数据文件，config 在 worktree 共享的 commondir 中
+    const QStringList gitFiles = {
         gitDir + "/index",   // 暂存区索引
         gitDir + "/HEAD",   // 当前分支指针
-        gitDir + "/config",   // 仓库配置
+        commonDir + "/config",   // 仓库配置
         gitDir + "/FETCH_HEAD",   // fetch操作记录
         gitDir + "/ORIG_HEAD",   // 操作前HEAD
         gitDir + "/MERGE_HEAD",   // 合并状态
@@ -318,14 +696,38 @@ QStringList GitFileSystemWatcher::getGitMetadataFiles(const QString &repositoryP
 
     for (const QString &file : gitFiles) {
         if (QFileInfo::exists(file)) {
-            files.append(file);
+            files.insert(file, classifyMetadata(QFileInfo(file).fileName()));
         }
     }
 
     return files;
 }
 
-QStringList GitFileSystemWatcher::getTrackedFiles(const QString &repositoryPath) const
+QHash<QString, int> GitFileSystemWatcher::getGitMetadataDirectories(const QString &gitDir)
+{
+    QHash<QString, int> dirs;
+    const QString &commonDir { Utils::gitCommonDirectory(gitDir) };
+
+    // git 目录中的增删只能按目录粗略分类：新建的 MERGE_HEAD、改名写入的 index 等都在 git 目录下
+    const QList<QPair<QString, int>> gitSubDirs = {
+        { gitDir, IndexChange | RefChange | FetchChange },
+        { commonDir, RefChange | FetchChange | ConfigChange },   // packed-refs、config
+        { commonDir + "/refs", RefChange },
+        { commonDir + "/refs/heads", RefChange },
+        { commonDir + "/refs/remotes", FetchChange },
+        { gitDir + "/logs", 0 }
+    };
+
+    for (const auto &subDir : gitSubDirs) {
+        if (!dirs.contains(subDir.first) && QDir(subDir.first).exists()) {
+            dirs.insert(subDir.first, subDir.second);
+        }
+    }
+
+    return dirs;
+}
+
+QStringList GitFileSystemWatcher::getTrackedFiles(const QString &repositoryPath, int maxFiles, bool *complete)
 {
     qInfo() << "INFO: [GitFileSystemWatcher] Getting tracked files for repository:" << repositoryPath;
 
@@ -338,6 +740,7 @@ QStringList GitFileSystemWatcher::getTrackedFiles(const QString &repositoryPath)
 
     if (!process.waitForFinished(5000)) {
         qWarning() << "WARNING: [GitFileSystemWatcher] Failed to get tracked files for repository:" << repositoryPath;
+        *complete = false;
         return trackedFiles;
     }
 
@@ -353,26 +756,20 @@ QStringList GitFileSystemWatcher::getTrackedFiles(const QString &repositoryPath)
     int fileCount = 0;
     int skippedCount = 0;
     for (const QString &relativePath : relativePaths) {
-        if (fileCount >= MAX_FILES_PER_REPO) {
+        if (fileCount >= maxFiles) {
             qWarning() << "WARNING: [GitFileSystemWatcher] Reached maximum file limit ("
-                       << MAX_FILES_PER_REPO << ") for repository:" << repositoryPath;
+                       << maxFiles << ") for repository:" << repositoryPath;
+            *complete = false;
             break;
         }
 
         QString absolutePath = repositoryPath + "/" + relativePath;
         QFileInfo fileInfo(absolutePath);
 
+        // 被跟踪的文件不受忽略规则影响，全部监控
         if (fileInfo.exists() && fileInfo.isFile()) {
-            if (shouldWatchFile(absolutePath)) {
-                trackedFiles.append(absolutePath);
-                fileCount++;
-            } else {
-                skippedCount++;
-                // 输出一些被跳过的文件用于调试
-                if (skippedCount <= 5) {
-                    qDebug() << "[GitFileSystemWatcher] Skipped file:" << relativePath << "reason: filter";
-                }
-            }
+            trackedFiles.append(absolutePath);
+            fileCount++;
         } else {
             skippedCount++;
             if (skippedCount <= 5) {
@@ -391,42 +788,30 @@ QStringList GitFileSystemWatcher::getTrackedFiles(const QString &repositoryPath)
     return trackedFiles;
 }
 
-QStringList GitFileSystemWatcher::getImportantDirectories(const QString &repositoryPath) const
+QStringList GitFileSystemWatcher::getImportantDirectories(const QString &repositoryPath, int maxDirs, bool *complete)
 {
     QStringList dirs;
 
+    // 只监控元数据
+    if (maxDirs <= 0) {
+        return dirs;
+    }
+
     // 仓库根目录
     dirs.append(repositoryPath);
 
-    // .git目录及其重要子目录
-    QString gitDir = repositoryPath + "/.git";
-    if (QDir(gitDir).exists()) {
-        dirs.append(gitDir);
-
-        QStringList gitSubDirs = {
-            gitDir + "/refs",
-            gitDir + "/refs/heads",
-            gitDir + "/refs/remotes",
-            gitDir + "/logs"
-        };
-
-        for (const QString &subDir : gitSubDirs) {
-            if (QDir(subDir).exists()) {
-                dirs.append(subDir);
-            }
-        }
-    }
-
     // 添加工作目录的子目录监控（关键修复！）
     // 这样可以检测到新建文件和删除文件
     QDir repoDir(repositoryPath);
     QStringList subDirs = repoDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
 
     int dirCount = 0;
-    const int maxDirs = 5000;   // 限制监控的子目录数量
 
     for (const QString &subDirName : subDirs) {
-        if (dirCount >= maxDirs) break;
+        if (dirCount >= maxDirs) {
+            *complete = false;
+            break;
+        }
 
         QString subDirPath = repositoryPath + "/" + subDirName;
 
@@ -439,7 +824,10 @@ QStringList GitFileSystemWatcher::getImportantDirectories(const QString &reposit
             QStringList subSubDirs = subDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
 
             for (const QString &subSubDirName : subSubDirs) {
-                if (dirCount >= maxDirs) break;
+                if (dirCount >= maxDirs) {
+                    *complete = false;
+                    break;
+                }
 
                 QString subSubDirPath = subDirPath + "/" + subSubDirName;
                 if (shouldWatchDirectory(subSubDirPath, repositoryPath)) {
@@ -456,61 +844,10 @@ QStringList GitFileSystemWatcher::getImportantDirectories(const QString &reposit
     return dirs;
 }
 
-bool GitFileSystemWatcher::shouldWatchFile(const QString &filePath) const
-{
-    QFileInfo fileInfo(filePath);
-
-    // 检查文件是否存在
-    if (!fileInfo.exists() || !fileInfo.isFile()) {
-        return false;
-    }
-
-    QString fileName = fileInfo.fileName();
-    QString suffix = fileInfo.suffix().toLower();
-    QString absolutePath = fileInfo.absoluteFilePath();
-
-    // Git元数据文件始终监控
-    if (absolutePath.contains("/.git/")) {
-        return true;
-    }
-
-    // 忽略的文件后缀（扩展列表，忽略更多构建和临时文件）
-    static const QStringList ignoredSuffixes = {
-        "tmp", "temp", "bak", "swp", "swo", "~",
-        "o", "obj", "exe", "dll", "so", "a", "lib",
-        "pyc", "pyo", "class", "d", "ts", "qm", "moc",
-        "cache", "log", "out", "debug", "cmake", "make",
-        "json", "txt", "internal", "depends"
-    };
-
-    if (ignoredSuffixes.contains(suffix)) {
-        return false;
-    }
-
-    // 忽略隐藏文件（除了Git相关，但允许更多常见文件）
-    if (fileName.startsWith(".") && fileName != ".gitignore" && fileName != ".gitmodules" && fileName != ".gitattributes" && !fileName.endsWith(".md")) {
-        return false;
-    }
-
-    // 忽略在构建/缓存目录中的文件（更精确的路径匹配）
-    static const QStringList ignoredPaths = {
-        "/node_modules/", "/build/", "/dist/", "/.vscode/", "/.idea/", "/__pycache__/"
-    };
-
-    for (const QString &ignoredPath : ignoredPaths) {
-        if (absolutePath.contains(ignoredPath)) {
-            return false;
-        }
-    }
-
-    // 默认允许监控（更宽松的策略）
-    return true;
-}
-
-bool GitFileSystemWatcher::shouldWatchDirectory(const QString &dirPath, const QString &repositoryPath) const
+bool GitFileSystemWatcher::shouldWatchDirectory(const QString &dirPath, const QString &repositoryPath)
 {
     // 确保目录在仓库中
-    if (!dirPath.startsWith(repositoryPath)) {
+    if (!dirPath.startsWith(repositoryPath + '/')) {
         return false;
     }
 
@@ -519,31 +856,15 @@ bool GitFileSystemWatcher::shouldWatchDirectory(const QString &dirPath, const QS
         return false;
     }
 
-    QString dirName = dirInfo.fileName();
-
-    // 忽略的目录名（扩展列表，包含更多构建目录）
-    static const QStringList ignoredDirs = {
-        "node_modules", "build", "dist", "target", "bin", "obj",
-        "__pycache__", ".vscode", ".idea", ".vs", "CMakeFiles",
-        "tmp", "temp", "cache", ".cache", "debian", ".debhelper",
-        ".clangd", "autogen", "_autogen"
-    };
-
-    if (ignoredDirs.contains(dirName)) {
-        return false;
-    }
-
-    // .git目录及其子目录特殊处理
-    if (dirName == ".git" || dirPath.contains("/.git/")) {
-        return true;
-    }
-
-    // 忽略以.开头的隐藏目录
-    if (dirName.startsWith(".")) {
+    // git 目录由 getGitMetadataDirectories() 单独监控，嵌套仓库的 .git 属于其自身的仓库
+    if (dirInfo.fileName() == ".git" || dirPath.contains("/.git/")) {
         return false;
     }
 
-    return true;
+    // 被忽略的目录内部的变化不需要监控，除非其中有被跟踪的文件（忽略规则对它们不起作用）
+    const QString &relativePath { dirPath.mid(repositoryPath.size() + 1) };
+    return !GitIgnoreMatcher::instance().isIgnored(repositoryPath, relativePath, true)
+            || Utils::containsTrackedFiles(repositoryPath, relativePath);
 }
 
 QString GitFileSystemWatcher::getRepositoryFromPath(const QString &filePath) const
@@ -551,50 +872,47 @@ QString GitFileSystemWatcher::getRepositoryFromPath(const QString &filePath) con
     QFileInfo fileInfo(filePath);
     QString absolutePath = fileInfo.absoluteFilePath();
 
-    // 查找匹配的仓库（从最长路径开始匹配）
-    QString bestMatch;
-    for (const QString &repoPath : m_repositories) {
-        if ((absolutePath.startsWith(repoPath + "/") || absolutePath == repoPath) && repoPath.length() > bestMatch.length()) {
-            bestMatch = repoPath;
-        }
-    }
-
-    return bestMatch;
+    // 最长前缀匹配，嵌套仓库命中最内层
+    return m_repositoryIndex.longestPrefix(absolutePath);
 }
 
-void GitFileSystemWatcher::scheduleUpdate(const QString &repositoryPath)
+void GitFileSystemWatcher::scheduleUpdate(const QString &repositoryPath, int changes, const QString &path)
 {
-    if (repositoryPath.isEmpty() || !m_repositories.contains(repositoryPath)) {
+    if (repositoryPath.isEmpty() || !m_repositories.contains(repositoryPath) || !changes) {
         return;
     }
 
-    m_pendingUpdates.insert(repositoryPath);
+    // 累积类别与工作区路径，由检索端选择代价最小的刷新方式；路径过多时退化为检索整个工作区
+    const bool alreadyPending { m_pendingUpdates.contains(repositoryPath) };
+    PendingChange &pending { m_pendingUpdates[repositoryPath] };
+    pending.changes |= changes;
+    if (changes & WorkTreeChange) {
+        if (path.isEmpty() || path == repositoryPath) {
+            pending.fullWorkTree = true;
+        } else if (!pending.fullWorkTree) {
+            pending.paths.insert(path);
+            if (pending.paths.size() > MAX_PENDING_PATHS)
+                pending.fullWorkTree = true;
+        }
+        if (pending.fullWorkTree)
+            pending.paths.clear();
+    }
+    m_dirtyRepositories.insert(repositoryPath);
 
-    // 启动或重启防抖定时器
-    m_updateTimer->start();
+    debounce(repositoryPath, alreadyPending);
+    armUpdateTimer();
 }
 
-void GitFileSystemWatcher::addWatchPaths(const QStringList &paths, bool isFile)
+void GitFileSystemWatcher::addWatchPaths(const QString &repositoryPath, const QStringList &paths)
 {
-    Q_UNUSED(isFile)   // 当前版本不需要区分文件和目录类型
-
     if (paths.isEmpty()) {
         return;
     }
 
-    // 过滤出有效路径
-    QStringList validPaths;
-    for (const QString &path : paths) {
-        if (QFileInfo::exists(path)) {
-            validPaths.append(path);
-        }
-    }
-
-    if (!validPaths.isEmpty()) {
-        // 直接添加所有路径（Qt会自动处理文件和目录的区别）
-        m_fileWatcher->addPaths(validPaths);
-        qInfo() << "INFO: [GitFileSystemWatcher] Added" << validPaths.size() << "paths to file watcher";
-    }
+    const bool idle { m_queuedWatches.isEmpty() };
+    m_queuedWatches[repositoryPath].append(paths);
+    if (idle)
+        QTimer::singleShot(0, this, &GitFileSystemWatcher::onApplyWatchBatch);
 }
 
 void GitFileSystemWatcher::checkAndAddNewDirectories(const QString &changedDirPath, const QString &repositoryPath)
@@ -604,11 +922,8 @@ void GitFileSystemWatcher::checkAndAddNewDirectories(const QString &changedDirPa
         return;
     }
 
-    // 获取当前正在监控的目录列表
-    QStringList currentlyWatched;
-    if (m_repoDirs.contains(repositoryPath)) {
-        currentlyWatched = m_repoDirs[repositoryPath];
-    }
+    // 当前正在监控的目录
+    QSet<QString> &currentlyWatched { m_repoDirs[repositoryPath] };
 
     // 获取变化目录下的所有子目录
     QStringList subDirs = changedDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
@@ -618,7 +933,7 @@ void GitFileSystemWatcher::checkAndAddNewDirectories(const QString &changedDirPa
         QString subDirPath = changedDirPath + "/" + subDirName;
 
         // 检查是否应该监控这个目录，且当前未被监控
-        if (shouldWatchDirectory(subDirPath, repositoryPath) && !currentlyWatched.contains(subDirPath)) {
+        if (!currentlyWatched.contains(subDirPath) && shouldWatchDirectory(subDirPath, repositoryPath)) {
 
             newDirsToWatch.append(subDirPath);
 
@@ -628,7 +943,7 @@ void GitFileSystemWatcher::checkAndAddNewDirectories(const QString &changedDirPa
 
             for (const QString &subSubDirName : subSubDirs) {
                 QString subSubDirPath = subDirPath + "/" + subSubDirName;
-                if (shouldWatchDirectory(subSubDirPath, repositoryPath) && !currentlyWatched.contains(subSubDirPath)) {
+                if (!currentlyWatched.contains(subSubDirPath) && shouldWatchDirectory(subSubDirPath, repositoryPath)) {
                     newDirsToWatch.append(subSubDirPath);
                 }
             }
@@ -637,14 +952,13 @@ void GitFileSystemWatcher::checkAndAddNewDirectories(const QString &changedDirPa
 
     // 添加新发现的目录到监控
     if (!newDirsToWatch.isEmpty()) {
-        m_fileWatcher->addPaths(newDirsToWatch);
+        const QStringList &failed { m_fileWatcher->addPaths(newDirsToWatch) };
 
         // 更新缓存
-        if (m_repoDirs.contains(repositoryPath)) {
-            m_repoDirs[repositoryPath].append(newDirsToWatch);
-        } else {
-            m_repoDirs[repositoryPath] = newDirsToWatch;
-        }
+        for (const QString &dirPath : std::as_const(newDirsToWatch))
+            currentlyWatched.insert(dirPath);
+        for (const QString &dirPath : failed)
+            currentlyWatched.remove(dirPath);
 
         qInfo() << "INFO: [GitFileSystemWatcher] Dynamically added" << newDirsToWatch.size()
                 << "new directories to monitoring:" << newDirsToWatch;
@@ -7,6 +7,15 @@
 #include <QSet>
 #include <QHash>
 #include <QStringList>
+#include <QPair>
+
+#include <pathindex.h>
+
+#include "gitwatchbudget.h"
+
+class QThread;
+class QThreadPool;
+class GitInotifyWatcher;
 
 /**
  * @brief Git仓库实时文件系统监控器
@@ -15,13 +24,43 @@
  * 1. 监控Git元数据文件变化（.git/index, .git/HEAD等）
  * 2. 监控工作目录文件变化（所有被Git跟踪的文件）
  * 3. 智能过滤和异步处理，避免性能问题
- * 4. 实时响应（100ms内）文件变化并触发更新
+ * 4. 自适应防抖：孤立的事件立即触发更新；事件持续到达时窗口按该仓库 git status 的耗时
+ *    逐次加倍（最长 MAX_DEBOUNCE_MS），但自第一个事件起最多等待 MIN_MAX_WAIT_MS～MAX_MAX_WAIT_MS
+ *    （检索耗时的 MAX_WAIT_COST_FACTOR 倍）就必定触发一次
+ *
+ * inotify 可用时由独立线程上的 GitInotifyWatcher 递归监控目录；
+ * 否则退回 QFileSystemWatcher 逐个监控被跟踪文件和部分目录，
+ * 其监控列表的计算（git ls-files、逐个文件检查）在线程池中进行，界面线程只负责分批添加路径；
+ * 被删除的路径在收到其变化通知时移出监控集合，不再定期逐个检查。
+ *
+ * 两种后端的监控数都由 GitWatchBudget 统一分配：配额不足时冷门仓库只监控元数据，
+ * 工作区的变化由定时的完整检索补上，重新可见时升级并补一次检索。
  */
 class GitFileSystemWatcher : public QObject
 {
     Q_OBJECT
+    friend class GitWatchSetupJob;
 
 public:
+    /**
+     * @brief 变化类别，不同类别需要的刷新代价不同，可组合
+     */
+    enum ChangeKind {
+        WorkTreeChange = 0x1,   ///< 工作区文件：按路径检索状态
+        IndexChange = 0x2,   ///< index、合并状态：完整检索状态
+        RefChange = 0x4,   ///< HEAD、本地分支、标签：刷新分支信息，HEAD 指向的提交变化时完整检索
+        FetchChange = 0x8,   ///< FETCH_HEAD、远程分支：只刷新领先/落后计数
+        ConfigChange = 0x10,   ///< 仓库配置：刷新分支信息并完整检索
+        AllChanges = WorkTreeChange | IndexChange | RefChange | FetchChange | ConfigChange
+    };
+
+    /**
+     * @brief 按文件名对 git 目录中的文件分类
+     * @param name git 目录下的文件名
+     * @return ChangeKind，无关的文件返回 0
+     */
+    static int classifyMetadata(const QString &name);
+
     explicit GitFileSystemWatcher(QObject *parent = nullptr);
     ~GitFileSystemWatcher();
 
@@ -50,12 +89,50 @@ public:
      */
     bool isWatching(const QString &repositoryPath) const;
 
+    /**
+     * @brief 更新窗口中可见的仓库，可见的仓库优先获得监控配额
+     * @param repositories 可见的仓库根目录
+     */
+    void setVisibleRepositories(const QSet<QString> &repositories);
+
+    /**
+     * @brief 仓库当前的监控配额分配
+     * @param repositoryPath 仓库路径
+     * @return 监控级别、配额以及工作区是否被完整监控
+     */
+    GitWatchBudget::Allocation watchAllocation(const QString &repositoryPath) const;
+
+    /**
+     * @brief 取出并清除仓库的变化标记
+     * @param repositoryPath 仓库路径
+     * @return 自上次调用以来是否观察到过该仓库的文件系统事件
+     */
+    bool takeDirty(const QString &repositoryPath);
+
+public Q_SLOTS:
+    /**
+     * @brief 记录仓库一次完整检索的耗时，用于调整防抖窗口
+     * @param repositoryPath 仓库路径
+     * @param cost 耗时（毫秒）
+     */
+    void setStatusCost(const QString &repositoryPath, qint64 cost);
+
 Q_SIGNALS:
     /**
      * @brief 仓库发生变化时发出的信号
      * @param repositoryPath 发生变化的仓库路径
+     * @param changes 防抖期间发生的 ChangeKind 组合
+     * @param paths 变化的工作区绝对路径；含 WorkTreeChange 而路径为空表示整个工作区
+     */
+    void repositoryChanged(const QString &repositoryPath, int changes, const QStringList &paths);
+
+    /**
+     * @brief 仓库内的文件或目录被改名/移动，只有 inotify 后端能够报告
+     * @param repositoryPath 仓库路径
+     * @param sources 原绝对路径
+     * @param targets 新绝对路径，与 sources 按下标对应
      */
-    void repositoryChanged(const QString &repositoryPath);
+    void repositoryPathsMoved(const QString &repositoryPath, const QStringList &sources, const QStringList &targets);
 
 private Q_SLOTS:
     /**
@@ -64,6 +141,22 @@ private Q_SLOTS:
      */
     void onFileChanged(const QString &path);
 
+    /**
+     * @brief inotify 后端报告仓库变化
+     * @param repositoryPath 仓库路径
+     */
+    void onInotifyRepositoryChanged(const QString &repositoryPath, int changes, const QStringList &paths);
+
+    /**
+     * @brief inotify 后端报告仓库的监控用量
+     */
+    void onInotifyWatchUsage(const QString &repositoryPath, int used, bool complete);
+
+    /**
+     * @brief inotify 后端报告仓库内的改名
+     */
+    void onInotifyPathsMoved(const QString &repositoryPath, const QStringList &sources, const QStringList &targets);
+
     /**
      * @brief 目录变化处理槽函数
      * @param path 变化的目录路径
@@ -71,22 +164,106 @@ private Q_SLOTS:
     void onDirectoryChanged(const QString &path);
 
     /**
-     * @brief 防抖更新处理槽函数
+     * @brief 发出已到期的仓库更新
      */
     void onDelayedUpdate();
 
     /**
-     * @brief 定期清理无效路径
+     * @brief 检查被挂起的仓库，git 操作结束或等待超时后发出一次更新
+     */
+    void onHoldTimeout();
+
+    /**
+     * @brief 每轮事件循环向 QFileSystemWatcher 添加一批排队的路径
      */
-    void onCleanupPaths();
+    void onApplyWatchBatch();
 
 private:
+    /**
+     * @brief 防抖期间累积的变化
+     */
+    struct PendingChange
+    {
+        int changes { 0 };   ///< ChangeKind 组合
+        QSet<QString> paths;   ///< 变化的工作区绝对路径
+        bool fullWorkTree { false };   ///< 整个工作区都需要检索（路径过多或无法确定）
+    };
+
+    /**
+     * @brief 单个仓库的防抖状态
+     */
+    struct Debounce
+    {
+        qint64 lastEvent { 0 };   ///< 最近一次事件的时间
+        qint64 pendingSince { 0 };   ///< 本次待发更新的第一个事件的时间
+        qint64 deadline { 0 };   ///< 计划发出更新的时间
+        qint64 window { 0 };   ///< 当前的防抖窗口，负载持续时加倍
+    };
+
+    /**
+     * @brief 后台计算出的仓库监控列表，路径均已确认存在
+     */
+    struct WatchSet
+    {
+        QStringList files;
+        QStringList directories;
+        QHash<QString, int> metadata;   ///< git 目录中的监控路径 -> ChangeKind
+        bool complete { true };   ///< 配额内是否容纳了所有被跟踪文件与目录
+    };
+
+    /**
+     * @brief 计算仓库的监控列表，在线程池中调用
+     * @param repositoryPath 仓库路径
+     * @param limit 监控数配额，0 表示只监控元数据
+     */
+    static WatchSet computeWatchSet(const QString &repositoryPath, int limit);
+
+    /**
+     * @brief 监控列表计算完成，在界面线程调用
+     * @param repositoryPath 仓库路径
+     * @param serial 设置序号，过期的结果丢弃
+     * @param watchSet 监控列表
+     */
+    void onWatchSetReady(const QString &repositoryPath, quint64 serial, const WatchSet &watchSet);
+
+    /**
+     * @brief 监控路径已被删除或移走，QFileSystemWatcher 已自行停止监控，同步移出监控集合
+     * @param repositoryPath 仓库路径
+     * @param path 监控的文件或目录
+     */
+    void forgetWatchedPath(const QString &repositoryPath, const QString &path);
+
+    /**
+     * @brief git 目录中的监控路径发生变化时按监控时记录的类别调度更新
+     *
+     * worktree 的 git 目录不在工作区内，共享的 commondir 可能属于多个仓库，不能按路径前缀归属。
+     * @param path 变化的文件或目录
+     * @return 是否为 git 目录中的监控路径
+     */
+    bool scheduleMetadataUpdate(const QString &path);
+
     /**
      * @brief 设置仓库监控
      * @param repositoryPath 仓库路径
      */
     void setupRepositoryWatching(const QString &repositoryPath);
 
+    /**
+     * @brief 重新分配监控配额并应用到发生变化的仓库
+     */
+    void rebalanceWatches();
+
+    /**
+     * @brief 按仓库当前的配额调整监控
+     * @param repositoryPath 仓库路径
+     */
+    void applyAllocation(const QString &repositoryPath);
+
+    /**
+     * @brief 仓库的监控数配额，只监控元数据时为 0
+     */
+    int watchLimit(const QString &repositoryPath) const;
+
     /**
      * @brief 移除仓库监控
      * @param repositoryPath 仓库路径
@@ -94,40 +271,44 @@ private:
     void removeRepositoryWatching(const QString &repositoryPath);
 
     /**
-     * @brief 获取仓库的Git元数据文件
-     * @param repositoryPath 仓库路径
-     * @return Git文件路径列表
+     * @brief 获取仓库的Git元数据文件，兼容 worktree/submodule 的 git 目录
+     * @param gitDir 仓库的 git 目录
+     * @return 存在的元数据文件 -> ChangeKind
      */
-    QStringList getGitMetadataFiles(const QString &repositoryPath) const;
+    static QHash<QString, int> getGitMetadataFiles(const QString &gitDir);
+
+    /**
+     * @brief 获取仓库 git 目录中需要监控的目录，refs 在共享的 commondir 中
+     * @param gitDir 仓库的 git 目录
+     * @return 存在的目录 -> ChangeKind
+     */
+    static QHash<QString, int> getGitMetadataDirectories(const QString &gitDir);
 
     /**
      * @brief 获取仓库的被跟踪文件
      * @param repositoryPath 仓库路径
+     * @param maxFiles 最多返回的文件数
+     * @param complete 输出是否返回了所有被跟踪文件
      * @return 被跟踪文件路径列表
      */
-    QStringList getTrackedFiles(const QString &repositoryPath) const;
+    static QStringList getTrackedFiles(const QString &repositoryPath, int maxFiles, bool *complete);
 
     /**
-     * @brief 获取仓库的重要目录
+     * @brief 获取仓库的重要工作区目录
      * @param repositoryPath 仓库路径
+     * @param maxDirs 最多返回的工作区目录数，0 表示不监控工作区
+     * @param complete 输出是否返回了所有候选的工作区目录
      * @return 重要目录路径列表
      */
-    QStringList getImportantDirectories(const QString &repositoryPath) const;
+    static QStringList getImportantDirectories(const QString &repositoryPath, int maxDirs, bool *complete);
 
     /**
-     * @brief 检查文件是否应该被监控
-     * @param filePath 文件路径
-     * @return 是否应该监控
-     */
-    bool shouldWatchFile(const QString &filePath) const;
-
-    /**
-     * @brief 检查目录是否应该被监控
+     * @brief 检查目录是否应该被监控，被 gitignore 忽略的目录不监控
      * @param dirPath 目录路径
      * @param repositoryPath 仓库路径
      * @return 是否应该监控
      */
-    bool shouldWatchDirectory(const QString &dirPath, const QString &repositoryPath) const;
+    static bool shouldWatchDirectory(const QString &dirPath, const QString &repositoryPath);
 
     /**
      * @brief 从文件路径获取仓库路径
@@ -139,15 +320,53 @@ private:
     /**
      * @brief 调度仓库更新（防抖处理）
      * @param repositoryPath 仓库路径
+     * @param changes ChangeKind 组合
+     * @param path 变化的工作区绝对路径，为空且含 WorkTreeChange 时表示整个工作区
+     */
+    void scheduleUpdate(const QString &repositoryPath, int changes, const QString &path = QString());
+
+    /**
+     * @brief 计算仓库下次发出更新的时间
+     *
+     * 安静一段时间后的孤立事件立即刷新；刚刷新过又有事件说明负载持续，窗口逐次加倍；
+     * 事件不断到达时向后顺延，但距第一个事件不超过最长等待时间。
+     * 窗口与最长等待时间按该仓库完整检索的耗时缩放。
+     *
+     * @param repositoryPath 仓库路径
+     * @param alreadyPending 事件到达前仓库已有待发的更新
+     */
+    void debounce(const QString &repositoryPath, bool alreadyPending);
+
+    /**
+     * @brief 按最早到期的仓库启动防抖定时器
      */
-    void scheduleUpdate(const QString &repositoryPath);
+    void armUpdateTimer();
 
     /**
-     * @brief 批量添加监控路径
+     * @brief git 正在修改仓库时挂起更新，避免检索到操作中途的状态
+     * @param repositoryPath 仓库路径
+     * @param change 防抖期间累积的变化
+     * @return 已挂起返回 true，调用方不应再发出更新
+     */
+    bool holdUpdate(const QString &repositoryPath, const PendingChange &change);
+
+    /**
+     * @brief 检查 git 是否正在修改仓库（index.lock、rebase、merge 进行中）
+     * @param repositoryPath 仓库路径
+     */
+    static bool isOperationInProgress(const QString &repositoryPath);
+
+    /**
+     * @brief 合并两次累积的变化
+     */
+    static void mergeChange(PendingChange *target, const PendingChange &change);
+
+    /**
+     * @brief 排队添加监控路径，由 onApplyWatchBatch() 分批加入 QFileSystemWatcher
+     * @param repositoryPath 仓库路径
      * @param paths 路径列表
-     * @param isFile 是否为文件路径
      */
-    void addWatchPaths(const QStringList &paths, bool isFile = true);
+    void addWatchPaths(const QString &repositoryPath, const QStringList &paths);
 
     /**
      * @brief 检测并添加新建的子目录到监控
@@ -157,20 +376,44 @@ private:
     void checkAndAddNewDirectories(const QString &changedDirPath, const QString &repositoryPath);
 
 private:
-    QFileSystemWatcher *m_fileWatcher;           ///< Qt文件系统监控器
-    QTimer *m_updateTimer;                       ///< 防抖更新定时器
-    QTimer *m_cleanupTimer;                      ///< 清理定时器
+    QFileSystemWatcher *m_fileWatcher;           ///< Qt文件系统监控器（inotify 不可用时的后备）
+    GitInotifyWatcher *m_inotifyWatcher { nullptr };   ///< inotify 后端，运行在 m_inotifyThread
+    QThread *m_inotifyThread { nullptr };        ///< inotify 事件读取线程
+    QTimer *m_updateTimer;                       ///< 防抖定时器，在最早到期的仓库触发
 
     QSet<QString> m_repositories;                ///< 监控的仓库集合
-    QSet<QString> m_pendingUpdates;              ///< 待处理更新的仓库集合
+    Global::PathIndex m_repositoryIndex;         ///< 仓库路径前缀树（最长前缀匹配）
+    QHash<QString, PendingChange> m_pendingUpdates;   ///< 待处理更新的仓库 -> 累积的变化
+    QHash<QString, Debounce> m_debounces;        ///< 仓库 -> 防抖状态
+    QHash<QString, qint64> m_statusCosts;        ///< 仓库 -> 最近一次完整检索的耗时（毫秒）
+    QHash<QString, QPair<PendingChange, qint64>> m_heldUpdates;   ///< 因 git 操作挂起的仓库 -> (变化, 开始挂起的时间)
+    QTimer *m_holdTimer;                         ///< 挂起期间定期检查操作是否结束
+    QThreadPool *m_setupPool;                    ///< 计算监控列表的线程池
+    QHash<QString, quint64> m_setupSerials;      ///< 正在后台设置的仓库 -> 设置序号
+    quint64 m_lastSetupSerial { 0 };
+    QHash<QString, QStringList> m_queuedWatches;   ///< 仓库 -> 尚未加入 QFileSystemWatcher 的路径
+    QSet<QString> m_dirtyRepositories;           ///< 上次 takeDirty() 之后有过事件的仓库
+    GitWatchBudget m_budget;                     ///< 跨仓库的监控配额
+    QHash<QString, GitWatchBudget::Level> m_watchLevels;   ///< 仓库 -> 已应用的监控级别
     
-    QHash<QString, QStringList> m_repoFiles;     ///< 每个仓库的监控文件
-    QHash<QString, QStringList> m_repoDirs;      ///< 每个仓库的监控目录
+    QHash<QString, QSet<QString>> m_repoFiles;   ///< 每个仓库的监控文件
+    QHash<QString, QSet<QString>> m_repoDirs;    ///< 每个仓库的监控目录
+    QHash<QString, QHash<QString, int>> m_metadataPaths;   ///< git 目录中的监控路径 -> (仓库 -> ChangeKind)
 
     // 配置常量
-    static constexpr int UPDATE_DELAY_MS = 100;        ///< 更新延迟时间
-    static constexpr int CLEANUP_INTERVAL_MS = 30000;  ///< 清理间隔时间
-    static constexpr int MAX_FILES_PER_REPO = 5000;    ///< 每个仓库最大监控文件数
+    static constexpr qint64 DEFAULT_STATUS_COST_MS = 100;   ///< 尚未测得检索耗时时的估计值
+    static constexpr qint64 MIN_DEBOUNCE_MS = 50;      ///< 防抖窗口的下限
+    static constexpr qint64 MAX_BASE_DEBOUNCE_MS = 1000;   ///< 初始窗口的上限
+    static constexpr qint64 MIN_MAX_DEBOUNCE_MS = 500;     ///< 窗口增长上限的下限
+    static constexpr qint64 MAX_DEBOUNCE_MS = 5000;    ///< 窗口增长上限的上限
+    static constexpr qint64 DEBOUNCE_COST_FACTOR = 4;  ///< 窗口最多增长到检索耗时的倍数
+    static constexpr qint64 MIN_MAX_WAIT_MS = 2000;    ///< 持续事件下最长等待时间的下限
+    static constexpr qint64 MAX_MAX_WAIT_MS = 10000;   ///< 持续事件下最长等待时间的上限
+    static constexpr qint64 MAX_WAIT_COST_FACTOR = 10;   ///< 最长等待时间为检索耗时的倍数
+    static constexpr int MAX_PENDING_PATHS = 256;      ///< 超过后不再按路径检索，改为完整检索
+    static constexpr int HOLD_POLL_INTERVAL_MS = 250;  ///< 挂起期间检查 git 操作是否结束的间隔
+    static constexpr int APPLY_BATCH_SIZE = 256;       ///< 每轮事件循环添加的监控路径数
+    static constexpr qint64 MAX_HOLD_MS = 3000;        ///< 最长挂起时间，长时间停留的 rebase/merge 仍定期刷新
 };
 
 #endif // GITFILESYSTEMWATCHER_H
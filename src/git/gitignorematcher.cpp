@@ -0,0 +1,614 @@
+#include "gitignorematcher.h"
+#include "utils.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QProcess>
+#include <QVector>
+#include <QStringView>
+#include <QDebug>
+
+namespace {
+
+enum WildResult {
+    WildMatch,
+    WildNoMatch,
+    WildAbortAll,
+    WildAbortToStarStar
+};
+
+bool isGlobSpecial(QChar ch)
+{
+    return ch == '*' || ch == '?' || ch == '[' || ch == '\\';
+}
+
+bool hasWildcard(const QString &pattern)
+{
+    for (const QChar ch : pattern) {
+        if (isGlobSpecial(ch))
+            return true;
+    }
+    return false;
+}
+
+const QChar *findSlash(const QChar *text)
+{
+    while (!text->isNull() && *text != '/')
+        ++text;
+    return text->isNull() ? nullptr : text;
+}
+
+bool matchCharacterClass(const QString &name, QChar ch, bool *valid)
+{
+    if (name == QLatin1String("alnum"))
+        return ch.isLetterOrNumber();
+    if (name == QLatin1String("alpha"))
+        return ch.isLetter();
+    if (name == QLatin1String("blank"))
+        return ch == ' ' || ch == '\t';
+    if (name == QLatin1String("cntrl"))
+        return ch.category() == QChar::Other_Control;
+    if (name == QLatin1String("digit"))
+        return ch.isDigit();
+    if (name == QLatin1String("graph"))
+        return ch.isPrint() && !ch.isSpace();
+    if (name == QLatin1String("lower"))
+        return ch.isLower();
+    if (name == QLatin1String("print"))
+        return ch.isPrint();
+    if (name == QLatin1String("punct"))
+        return ch.isPunct();
+    if (name == QLatin1String("space"))
+        return ch.isSpace();
+    if (name == QLatin1String("upper"))
+        return ch.isUpper();
+    if (name == QLatin1String("xdigit"))
+        return ch.isDigit() || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F');
+    *valid = false;
+    return false;
+}
+
+// git 的 wildmatch（WM_PATHNAME）：'*'、'?'、'[...]' 不匹配 '/'，
+// 前后都是 '/'（或位于模式首尾）的 "**" 匹配任意层目录。两个参数都必须以 '\0' 结尾
+int doWild(const QChar *p, const QChar *text)
+{
+    const QChar *pattern { p };
+    for (; !p->isNull(); ++text, ++p) {
+        QChar pCh { *p };
+        QChar tCh { *text };
+        if (tCh.isNull() && pCh != '*')
+            return WildAbortAll;
+
+        switch (pCh.unicode()) {
+        case '\\':
+            // 转义字符按字面匹配
+            pCh = *++p;
+            Q_FALLTHROUGH();
+        default:
+            if (tCh != pCh)
+                return WildNoMatch;
+            continue;
+        case '?':
+            if (tCh == '/')
+                return WildNoMatch;
+            continue;
+        case '*': {
+            bool matchSlash { false };
+            if (*++p == '*') {
+                const QChar *previous { p - 2 };
+                while (*++p == '*') { }
+                if ((previous < pattern || *previous == '/')
+                    && (p->isNull() || *p == '/' || (p[0] == '\\' && p[1] == '/'))) {
+                    // "**/" 先尝试匹配零层目录，使 "a/**/b" 同时匹配 a/b 与 a/x/b
+                    if (*p == '/' && doWild(p + 1, text) == WildMatch)
+                        return WildMatch;
+                    matchSlash = true;
+                }
+            }
+            if (p->isNull()) {
+                // 结尾的 "**" 匹配一切，结尾的 "*" 只匹配不含 '/' 的剩余部分
+                if (!matchSlash && findSlash(text))
+                    return WildNoMatch;
+                return WildMatch;
+            }
+            if (!matchSlash && *p == '/') {
+                // 单个 '*' 后跟 '/'：匹配到下一个 '/'，该 '/' 由外层循环消耗
+                const QChar *slash { findSlash(text) };
+                if (!slash)
+                    return WildNoMatch;
+                text = slash;
+                break;
+            }
+            for (;;) {
+                if (tCh.isNull())
+                    break;
+                // '*' 后是字面字符时，直接跳到文本中下一个相同的字符
+                if (!isGlobSpecial(*p)) {
+                    pCh = *p;
+                    while (!(tCh = *text).isNull() && (matchSlash || tCh != '/')) {
+                        if (tCh == pCh)
+                            break;
+                        ++text;
+                    }
+                    if (tCh != pCh)
+                        return WildNoMatch;
+                }
+                const int matched { doWild(p, text) };
+                if (matched != WildNoMatch) {
+                    if (!matchSlash || matched != WildAbortToStarStar)
+                        return matched;
+                } else if (!matchSlash && tCh == '/') {
+                    return WildAbortToStarStar;
+                }
+                tCh = *++text;
+            }
+            return WildAbortAll;
+        }
+        case '[': {
+            pCh = *++p;
+            if (pCh == '^')
+                pCh = '!';
+            const bool negated { pCh == '!' };
+            if (negated)
+                pCh = *++p;
+            QChar previousCh;
+            bool matched { false };
+            do {
+                if (pCh.isNull())
+                    return WildAbortAll;
+                if (pCh == '\\') {
+                    pCh = *++p;
+                    if (pCh.isNull())
+                        return WildAbortAll;
+                    if (tCh == pCh)
+                        matched = true;
+                } else if (pCh == '-' && !previousCh.isNull() && !p[1].isNull() && p[1] != ']') {
+                    pCh = *++p;
+                    if (pCh == '\\') {
+                        pCh = *++p;
+                        if (pCh.isNull())
+                            return WildAbortAll;
+                    }
+                    if (tCh <= pCh && tCh >= previousCh)
+                        matched = true;
+                    pCh = QChar();
+                } else if (pCh == '[' && p[1] == ':') {
+                    const QChar *name { p += 2 };
+                    while (!(pCh = *p).isNull() && pCh != ']')
+                        ++p;
+                    if (pCh.isNull())
+                        return WildAbortAll;
+                    const int length { static_cast<int>(p - name) - 1 };
+                    if (length < 0 || p[-1] != ':') {
+                        // 不是 "[:class:]"，按普通字符处理
+                        p = name - 2;
+                        pCh = '[';
+                        if (tCh == pCh)
+                            matched = true;
+                        continue;
+                    }
+                    bool valid { true };
+                    if (matchCharacterClass(QString(name, length), tCh, &valid))
+                        matched = true;
+                    if (!valid)
+                        return WildAbortAll;
+                    pCh = QChar();
+                } else if (tCh == pCh) {
+                    matched = true;
+                }
+            } while (previousCh = pCh, (pCh = *++p) != ']');
+            if (matched == negated || tCh == '/')
+                return WildNoMatch;
+            continue;
+        }
+        }
+    }
+
+    return text->isNull() ? WildMatch : WildNoMatch;
+}
+
+bool wildmatch(const QString &pattern, const QString &text)
+{
+    // QString 的数据总是以 '\0' 结尾
+    return doWild(pattern.constData(), text.constData()) == WildMatch;
+}
+
+}   // namespace
+
+/**
+ * @brief 一个规则文件编译后的匹配表
+ *
+ * 不含通配符的模式按文件名或相对路径放入哈希表，"*.ext" 形式的模式按扩展名放入后缀表，
+ * 其余模式按出现顺序逐条 wildmatch。规则编号即出现顺序，编号最大的命中规则生效。
+ */
+class GitIgnoreRules
+{
+public:
+    enum Result {
+        NoMatch,
+        Ignored,
+        Included   ///< 命中 "!pattern"
+    };
+
+    explicit GitIgnoreRules(const QByteArray &content);
+
+    bool isEmpty() const { return m_rules.isEmpty(); }
+
+    /**
+     * @brief 匹配路径
+     * @param relativePath 相对规则文件所在目录的路径
+     * @param name 路径的最后一级名称
+     * @param isDirectory 路径是否为目录
+     */
+    Result match(const QString &relativePath, const QString &name, bool isDirectory) const;
+
+private:
+    struct Rule
+    {
+        QString pattern;   ///< 已去掉 "!"、开头与结尾的 "/"
+        bool negated { false };
+        bool directoryOnly { false };   ///< 以 "/" 结尾，只匹配目录
+        bool pathname { false };   ///< 含 "/"，相对规则文件所在目录匹配完整路径，否则只匹配名称
+    };
+
+    bool accepts(int index, bool isDirectory) const;
+
+    QVector<Rule> m_rules;
+    QHash<QString, QVector<int>> m_names;   ///< 不含通配符的名称模式
+    QHash<QString, QVector<int>> m_paths;   ///< 不含通配符的路径模式
+    QHash<QString, QVector<int>> m_suffixes;   ///< 扩展名 -> "*.ext" 形式的模式
+    QVector<int> m_wildcards;   ///< 其余模式，按出现顺序
+};
+
+GitIgnoreRules::GitIgnoreRules(const QByteArray &content)
+{
+    const QList<QByteArray> &lines { content.split('\n') };
+    for (QByteArray line : lines) {
+        if (line.endsWith('\r'))
+            line.chop(1);
+        // 结尾的空格被忽略，除非以 "\ " 转义
+        while (line.endsWith(' ') && !(line.size() >= 2 && line.at(line.size() - 2) == '\\'))
+            line.chop(1);
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        Rule rule;
+        QString pattern { QString::fromUtf8(line) };
+        if (pattern.startsWith('!')) {
+            rule.negated = true;
+            pattern.remove(0, 1);
+        }
+        if (pattern.endsWith('/')) {
+            rule.directoryOnly = true;
+            pattern.chop(1);
+        }
+        rule.pathname = pattern.contains('/');
+        if (pattern.startsWith('/'))
+            pattern.remove(0, 1);
+        if (pattern.isEmpty())
+            continue;
+
+        rule.pattern = pattern;
+        const int index { m_rules.size() };
+        m_rules.append(rule);
+
+        if (!hasWildcard(pattern)) {
+            (rule.pathname ? m_paths : m_names)[pattern].append(index);
+            continue;
+        }
+
+        const QString &suffix { pattern.mid(1) };
+        const int dot { suffix.lastIndexOf('.') };
+        if (!rule.pathname && pattern.startsWith('*') && dot >= 0 && !hasWildcard(suffix))
+            m_suffixes[suffix.mid(dot + 1)].append(index);
+        else
+            m_wildcards.append(index);
+    }
+}
+
+bool GitIgnoreRules::accepts(int index, bool isDirectory) const
+{
+    return isDirectory || !m_rules.at(index).directoryOnly;
+}
+
+GitIgnoreRules::Result GitIgnoreRules::match(const QString &relativePath, const QString &name, bool isDirectory) const
+{
+    int best { -1 };
+    const auto consider = [&](const QVector<int> &indexes) {
+        for (int index : indexes) {
+            if (index > best && accepts(index, isDirectory))
+                best = index;
+        }
+    };
+
+    auto names = m_names.constFind(name);
+    if (names != m_names.constEnd())
+        consider(names.value());
+
+    auto paths = m_paths.constFind(relativePath);
+    if (paths != m_paths.constEnd())
+        consider(paths.value());
+
+    const int dot { name.lastIndexOf('.') };
+    if (dot >= 0) {
+        auto suffixes = m_suffixes.constFind(name.mid(dot + 1));
+        if (suffixes != m_suffixes.constEnd()) {
+            for (int index : suffixes.value()) {
+                // 模式为 "*<suffix>"
+                if (index > best && accepts(index, isDirectory) && name.endsWith(QStringView(m_rules.at(index).pattern).mid(1)))
+                    best = index;
+            }
+        }
+    }
+
+    // 从后往前，编号小于当前结果的规则不可能再生效
+    for (int i = m_wildcards.size() - 1; i >= 0 && m_wildcards.at(i) > best; --i) {
+        const int index { m_wildcards.at(i) };
+        if (!accepts(index, isDirectory))
+            continue;
+        const Rule &rule { m_rules.at(index) };
+        if (wildmatch(rule.pattern, rule.pathname ? relativePath : name)) {
+            best = index;
+            break;
+        }
+    }
+
+    if (best < 0)
+        return NoMatch;
+    return m_rules.at(best).negated ? Included : Ignored;
+}
+
+GitIgnoreMatcher &GitIgnoreMatcher::instance()
+{
+    static GitIgnoreMatcher matcher;
+    return matcher;
+}
+
+bool GitIgnoreMatcher::isIgnored(const QString &repositoryPath, const QString &relativePath, bool isDirectory)
+{
+    QString path { relativePath };
+    while (path.endsWith('/'))
+        path.chop(1);
+    if (repositoryPath.isEmpty() || path.isEmpty() || path == QLatin1String(".") || path.startsWith(QLatin1String("..")))
+        return false;
+
+    QMutexLocker locker(&m_mutex);
+    Repository *repository { this->repository(repositoryPath) };
+    if (repository->globalPathStale) {
+        // git config 可能要等待上百毫秒，期间不阻塞其他仓库的判断；并发的调用各自解析，结果相同
+        locker.unlock();
+        const QString &globalPath { resolveGlobalExcludes(repositoryPath) };
+        locker.relock();
+        // 解锁期间其他线程可能插入仓库，哈希表中的地址不再可靠
+        repository = this->repository(repositoryPath);
+        applyGlobalExcludes(repository, globalPath);
+    }
+
+    // 父目录被忽略时不能再被重新包含
+    const int slash { path.lastIndexOf('/') };
+    if (slash > 0 && isDirectoryIgnored(repository, path.left(slash)))
+        return true;
+    if (isDirectory)
+        return isDirectoryIgnored(repository, path);
+    return matchPath(repository, path, false);
+}
+
+void GitIgnoreMatcher::invalidate(const QString &path)
+{
+    const QString &cleanPath { QDir::cleanPath(path) };
+    const bool isRuleFile { cleanPath.endsWith(QLatin1String("/.gitignore")) };
+    const QString &directory { isRuleFile ? cleanPath.left(cleanPath.lastIndexOf('/')) : cleanPath };
+
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_repositories.begin(); it != m_repositories.end(); ++it) {
+        QString relativeDir;
+        if (directory != it.key()) {
+            if (!directory.startsWith(it.key() + '/'))
+                continue;
+            relativeDir = directory.mid(it.key().size() + 1);
+        }
+
+        Repository &repository { it.value() };
+        if (isRuleFile) {
+            repository.directoryRules.remove(relativeDir);
+        } else {
+            // 目录被删除或移走，其下各级 .gitignore 一并丢弃
+            const QString &prefix { relativeDir + '/' };
+            for (auto rules = repository.directoryRules.begin(); rules != repository.directoryRules.end();) {
+                if (relativeDir.isEmpty() || rules.key() == relativeDir || rules.key().startsWith(prefix))
+                    rules = repository.directoryRules.erase(rules);
+                else
+                    ++rules;
+            }
+        }
+        repository.directoryDecisions.clear();
+    }
+}
+
+GitIgnoreMatcher::Repository *GitIgnoreMatcher::repository(const QString &repositoryPath)
+{
+    auto it = m_repositories.find(repositoryPath);
+    if (it != m_repositories.end()) {
+        validate(&it.value());
+        return &it.value();
+    }
+
+    Repository repository;
+    repository.path = repositoryPath;
+    const QString &gitDir { Utils::gitDirectory(repositoryPath) };
+    if (!gitDir.isEmpty()) {
+        // worktree 共享主仓库的 info/exclude 与配置
+        const QString &commonDir { Utils::gitCommonDirectory(gitDir) };
+        repository.excludePath = commonDir + "/info/exclude";
+        repository.configPath = commonDir + "/config";
+    }
+    repository.configModified = modifiedTime(repository.configPath);
+    repository.excludeRules = loadRules(repository.excludePath);
+    repository.validatedAt = QDateTime::currentMSecsSinceEpoch();
+
+    qDebug() << "[GitIgnoreMatcher] Loaded ignore rules for repository:" << repositoryPath;
+    return &m_repositories.insert(repositoryPath, repository).value();
+}
+
+void GitIgnoreMatcher::validate(Repository *repository)
+{
+    const qint64 now { QDateTime::currentMSecsSinceEpoch() };
+    if (now - repository->validatedAt < VALIDATE_INTERVAL_MS)
+        return;
+    repository->validatedAt = now;
+
+    bool changed { false };
+    const qint64 configModified { modifiedTime(repository->configPath) };
+    if (configModified != repository->configModified) {
+        repository->configModified = configModified;
+        repository->globalPathStale = true;
+    }
+    if (isStale(repository->excludeRules, repository->excludePath)) {
+        repository->excludeRules = loadRules(repository->excludePath);
+        changed = true;
+    }
+    if (!repository->globalPathStale && isStale(repository->globalRules, repository->globalPath)) {
+        repository->globalRules = loadRules(repository->globalPath);
+        changed = true;
+    }
+
+    if (changed) {
+        qDebug() << "[GitIgnoreMatcher] Exclude rules changed for repository:" << repository->path;
+        repository->directoryDecisions.clear();
+    }
+}
+
+void GitIgnoreMatcher::applyGlobalExcludes(Repository *repository, const QString &globalPath)
+{
+    repository->globalPathStale = false;
+    // 文件内容的变化由 validate() 按修改时间发现
+    if (globalPath == repository->globalPath)
+        return;
+
+    repository->globalPath = globalPath;
+    repository->globalRules = loadRules(globalPath);
+    repository->directoryDecisions.clear();
+    qDebug() << "[GitIgnoreMatcher] Using excludesFile:" << globalPath << "for repository:" << repository->path;
+}
+
+bool GitIgnoreMatcher::isDirectoryIgnored(Repository *repository, const QString &relativeDir)
+{
+    auto cached = repository->directoryDecisions.constFind(relativeDir);
+    if (cached != repository->directoryDecisions.constEnd())
+        return cached.value();
+
+    const int slash { relativeDir.lastIndexOf('/') };
+    const bool ignored { (slash > 0 && isDirectoryIgnored(repository, relativeDir.left(slash)))
+                         || matchPath(repository, relativeDir, true) };
+
+    if (repository->directoryDecisions.size() >= MAX_DECISIONS)
+        repository->directoryDecisions.clear();
+    repository->directoryDecisions.insert(relativeDir, ignored);
+    return ignored;
+}
+
+bool GitIgnoreMatcher::matchPath(Repository *repository, const QString &relativePath, bool isDirectory)
+{
+    const int slash { relativePath.lastIndexOf('/') };
+    const QString &name { slash >= 0 ? relativePath.mid(slash + 1) : relativePath };
+
+    // 从所在目录逐级向上，深层的 .gitignore 优先
+    QString directory { slash >= 0 ? relativePath.left(slash) : QString() };
+    for (;;) {
+        const std::shared_ptr<const GitIgnoreRules> &rules { directoryRules(repository, directory) };
+        if (rules) {
+            const QString &localPath { directory.isEmpty() ? relativePath : relativePath.mid(directory.size() + 1) };
+            const GitIgnoreRules::Result result { rules->match(localPath, name, isDirectory) };
+            if (result != GitIgnoreRules::NoMatch)
+                return result == GitIgnoreRules::Ignored;
+        }
+        if (directory.isEmpty())
+            break;
+        const int parent { directory.lastIndexOf('/') };
+        directory = parent >= 0 ? directory.left(parent) : QString();
+    }
+
+    for (const RuleFile *ruleFile : { &repository->excludeRules, &repository->globalRules }) {
+        if (!ruleFile->rules)
+            continue;
+        const GitIgnoreRules::Result result { ruleFile->rules->match(relativePath, name, isDirectory) };
+        if (result != GitIgnoreRules::NoMatch)
+            return result == GitIgnoreRules::Ignored;
+    }
+    return false;
+}
+
+std::shared_ptr<const GitIgnoreRules> GitIgnoreMatcher::directoryRules(Repository *repository, const QString &relativeDir)
+{
+    auto it = repository->directoryRules.constFind(relativeDir);
+    if (it != repository->directoryRules.constEnd())
+        return it->rules;
+
+    const QString &filePath { relativeDir.isEmpty() ? repository->path + "/.gitignore"
+                                                    : repository->path + '/' + relativeDir + "/.gitignore" };
+    const RuleFile &ruleFile { loadRules(filePath) };
+    repository->directoryRules.insert(relativeDir, ruleFile);
+    return ruleFile.rules;
+}
+
+GitIgnoreMatcher::RuleFile GitIgnoreMatcher::loadRules(const QString &filePath)
+{
+    RuleFile ruleFile;
+    if (filePath.isEmpty())
+        return ruleFile;
+
+    const QFileInfo info(filePath);
+    if (!info.isFile())
+        return ruleFile;
+    ruleFile.modified = info.lastModified().toMSecsSinceEpoch();
+    ruleFile.size = info.size();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "WARNING: [GitIgnoreMatcher] Failed to read ignore rules:" << filePath;
+        return ruleFile;
+    }
+    const auto rules { std::make_shared<const GitIgnoreRules>(file.readAll()) };
+    if (!rules->isEmpty())
+        ruleFile.rules = rules;
+    return ruleFile;
+}
+
+bool GitIgnoreMatcher::isStale(const RuleFile &ruleFile, const QString &filePath)
+{
+    if (filePath.isEmpty())
+        return false;
+    const QFileInfo info(filePath);
+    if (!info.isFile())
+        return ruleFile.modified >= 0;
+    return info.lastModified().toMSecsSinceEpoch() != ruleFile.modified || info.size() != ruleFile.size;
+}
+
+qint64 GitIgnoreMatcher::modifiedTime(const QString &filePath)
+{
+    if (filePath.isEmpty())
+        return -1;
+    const QFileInfo info(filePath);
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+QString GitIgnoreMatcher::resolveGlobalExcludes(const QString &repositoryPath)
+{
+    // 只在首次加载和仓库配置变化时读取，在工作区内运行以合并全局与仓库配置
+    QProcess process;
+    process.setWorkingDirectory(repositoryPath);
+    process.start("git", { "config", "--path", "core.excludesFile" });
+    if (process.waitForFinished(CONFIG_TIMEOUT_MS) && process.exitCode() == 0) {
+        const QString &path { QString::fromLocal8Bit(process.readAllStandardOutput()).trimmed() };
+        if (!path.isEmpty())
+            return QDir(repositoryPath).absoluteFilePath(path);
+    }
+
+    // 未设置时 git 使用 $XDG_CONFIG_HOME/git/ignore
+    QString configHome { QString::fromLocal8Bit(qgetenv("XDG_CONFIG_HOME")) };
+    if (configHome.isEmpty())
+        configHome = QDir::homePath() + "/.config";
+    return configHome + "/git/ignore";
+}
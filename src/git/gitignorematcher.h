@@ -0,0 +1,101 @@
+#ifndef GITIGNOREMATCHER_H
+#define GITIGNOREMATCHER_H
+
+#include <memory>
+
+#include <QString>
+#include <QHash>
+#include <QMutex>
+
+class GitIgnoreRules;
+
+/**
+ * @brief 进程内的 gitignore 匹配器
+ *
+ * 读取各级目录的 .gitignore、$GIT_COMMON_DIR/info/exclude 和 core.excludesFile，
+ * 每个规则文件编译为一组字面量/后缀哈希表，只有含通配符的模式才逐条 wildmatch，
+ * 判断一个路径只需几次哈希查找，不再为每个路径询问 git check-ignore。
+ *
+ * 语义与 git 一致：
+ * - 深层目录的 .gitignore 优先于浅层，均优先于 info/exclude，再次是 core.excludesFile；
+ * - 同一文件中最后命中的规则生效，"!pattern" 重新包含；
+ * - 父目录被忽略时其下的路径都被忽略，不能再被重新包含。
+ *
+ * 目录的判断结果按仓库缓存。工作区中的 .gitignore 变化由文件监控器调用 invalidate()，
+ * info/exclude 与配置不在监控范围内，每 VALIDATE_INTERVAL_MS 检查一次修改时间。
+ * core.excludesFile 由 git config 解析，只在首次使用和配置变化时进行，且不持有全局锁。
+ *
+ * 线程安全，可在任意线程调用。
+ */
+class GitIgnoreMatcher
+{
+public:
+    static GitIgnoreMatcher &instance();
+
+    /**
+     * @brief 判断路径是否被忽略
+     * @param repositoryPath 仓库根目录
+     * @param relativePath 相对仓库根目录的路径
+     * @param isDirectory 路径是否为目录（以 "/" 结尾的规则只匹配目录）
+     * @return 被忽略返回 true
+     */
+    bool isIgnored(const QString &repositoryPath, const QString &relativePath, bool isDirectory);
+
+    /**
+     * @brief 规则文件或目录发生变化，丢弃相关的规则与判断结果
+     * @param path .gitignore 文件或被删除/移走的目录的绝对路径
+     */
+    void invalidate(const QString &path);
+
+private:
+    GitIgnoreMatcher() = default;
+
+    /**
+     * @brief 一个规则文件的编译结果与其修改时间
+     */
+    struct RuleFile
+    {
+        std::shared_ptr<const GitIgnoreRules> rules;   ///< 文件不存在时为空
+        qint64 modified { -1 };
+        qint64 size { -1 };
+    };
+
+    /**
+     * @brief 单个仓库的规则与判断缓存
+     */
+    struct Repository
+    {
+        QString path;   ///< 仓库根目录
+        QHash<QString, RuleFile> directoryRules;   ///< 相对目录（根目录为空串）-> 该目录的 .gitignore
+        RuleFile excludeRules;   ///< info/exclude
+        RuleFile globalRules;   ///< core.excludesFile
+        QString excludePath;
+        QString globalPath;
+        QString configPath;   ///< 仓库配置，变化时重新读取 core.excludesFile
+        qint64 configModified { -1 };
+        bool globalPathStale { true };   ///< core.excludesFile 需要重新解析（运行 git config，在锁外进行）
+        QHash<QString, bool> directoryDecisions;   ///< 相对目录 -> 是否被忽略
+        qint64 validatedAt { 0 };
+    };
+
+    Repository *repository(const QString &repositoryPath);
+    void validate(Repository *repository);
+    void applyGlobalExcludes(Repository *repository, const QString &globalPath);
+    bool isDirectoryIgnored(Repository *repository, const QString &relativeDir);
+    bool matchPath(Repository *repository, const QString &relativePath, bool isDirectory);
+    std::shared_ptr<const GitIgnoreRules> directoryRules(Repository *repository, const QString &relativeDir);
+
+    static RuleFile loadRules(const QString &filePath);
+    static bool isStale(const RuleFile &ruleFile, const QString &filePath);
+    static qint64 modifiedTime(const QString &filePath);
+    static QString resolveGlobalExcludes(const QString &repositoryPath);
+
+    QMutex m_mutex;
+    QHash<QString, Repository> m_repositories;   ///< 仓库根目录 -> 规则与判断缓存
+
+    static constexpr qint64 VALIDATE_INTERVAL_MS = 2000;   ///< info/exclude、配置的检查间隔
+    static constexpr int MAX_DECISIONS = 16384;   ///< 每个仓库缓存的目录判断数，超过后清空
+    static constexpr int CONFIG_TIMEOUT_MS = 1000;   ///< 读取 core.excludesFile 的最长等待时间
+};
+
+#endif   // GITIGNOREMATCHER_H
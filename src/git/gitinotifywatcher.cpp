@@ -0,0 +1,428 @@
+#include "gitinotifywatcher.h"
+#include "gitfilesystemwatcher.h"
+#include "gitignorematcher.h"
+#include "gitrepositoryresolver.h"
+#include "utils.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QPair>
+#include <QSocketNotifier>
+#include <QDebug>
+
+#include <cache.h>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+constexpr uint32_t kDirectoryMask { IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO
+                                    | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK };
+}   // namespace
+
+GitInotifyWatcher::GitInotifyWatcher(QObject *parent)
+    : QObject(parent),
+      m_fd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+    if (m_fd < 0)
+        qWarning() << "WARNING: [GitInotifyWatcher] inotify unavailable:" << std::strerror(errno);
+}
+
+GitInotifyWatcher::~GitInotifyWatcher()
+{
+    // 关闭 fd 会一并移除所有监控
+    if (m_fd >= 0)
+        ::close(m_fd);
+}
+
+void GitInotifyWatcher::initialize()
+{
+    if (m_fd < 0 || m_notifier)
+        return;
+
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &GitInotifyWatcher::onReadyRead);
+    qInfo() << "INFO: [GitInotifyWatcher] inotify watcher running";
+}
+
+void GitInotifyWatcher::addRepository(const QString &repositoryPath, int limit)
+{
+    if (m_fd < 0 || repositoryPath.isEmpty() || m_repositories.contains(repositoryPath))
+        return;
+
+    m_repositories.insert(repositoryPath);
+    m_limits.insert(repositoryPath, limit);
+    watchRepository(repositoryPath);
+    reportUsage(repositoryPath);
+
+    qInfo() << "INFO: [GitInotifyWatcher] Watching repository:" << repositoryPath
+            << "directories:" << m_repositoryWatches.value(repositoryPath).size() << "limit:" << limit;
+}
+
+void GitInotifyWatcher::removeRepository(const QString &repositoryPath)
+{
+    if (!m_repositories.remove(repositoryPath))
+        return;
+
+    const QSet<int> watches { m_repositoryWatches.take(repositoryPath) };
+    for (int wd : watches)
+        removeWatch(wd);
+    m_limits.remove(repositoryPath);
+    m_truncated.remove(repositoryPath);
+
+    qInfo() << "INFO: [GitInotifyWatcher] Stopped watching repository:" << repositoryPath;
+}
+
+void GitInotifyWatcher::setRepositoryLimit(const QString &repositoryPath, int limit)
+{
+    if (!m_repositories.contains(repositoryPath))
+        return;
+
+    const int previous { m_limits.value(repositoryPath) };
+    m_limits.insert(repositoryPath, limit);
+
+    // 超出新配额时整体收回再按广度优先重新监控，保留浅层目录
+    const bool shrink { limit <= 0 || m_repositoryWatches.value(repositoryPath).size() > limit };
+    const bool grow { limit > 0 && (shrink || previous <= 0 || m_truncated.contains(repositoryPath)) };
+    if (shrink)
+        removeWorkTree(repositoryPath);
+    if (grow) {
+        m_truncated.remove(repositoryPath);
+        watchTree(repositoryPath, repositoryPath);
+    }
+    if (!shrink && !grow)
+        return;
+
+    qInfo() << "INFO: [GitInotifyWatcher] Watch limit of repository:" << repositoryPath << "changed from" << previous
+            << "to" << limit << "directories:" << m_repositoryWatches.value(repositoryPath).size();
+    reportUsage(repositoryPath);
+}
+
+void GitInotifyWatcher::watchRepository(const QString &repositoryPath)
+{
+    // git 目录：index、HEAD、packed-refs 等都由 git 以 "写 .lock 再改名" 的方式更新，
+    // 监控目录本身即可看到；refs 目录递归监控以发现分支变化
+    const QString &gitDir { Utils::gitDirectory(repositoryPath) };
+    if (!gitDir.isEmpty()) {
+        addWatch(gitDir, repositoryPath, WatchKind::GitDirectory);
+        const QString &commonDir { Utils::gitCommonDirectory(gitDir) };
+        if (commonDir != gitDir)
+            addWatch(commonDir, repositoryPath, WatchKind::GitDirectory);
+        // 远程分支只在 fetch/push 时变化，单独分类
+        watchRefs(commonDir + "/refs", repositoryPath, WatchKind::Refs);
+    }
+
+    watchTree(repositoryPath, repositoryPath);
+}
+
+void GitInotifyWatcher::watchRefs(const QString &directory, const QString &repositoryPath, WatchKind kind)
+{
+    QList<QPair<QString, WatchKind>> pending { { directory, kind } };
+    while (!pending.isEmpty()) {
+        const auto current { pending.takeLast() };
+        if (addWatch(current.first, repositoryPath, current.second) < 0)
+            continue;
+        const QStringList &children { QDir(current.first).entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks) };
+        for (const QString &child : children)
+            pending.append({ current.first + '/' + child, childRefsKind(current.first, child, current.second) });
+    }
+}
+
+void GitInotifyWatcher::watchTree(const QString &directory, const QString &repositoryPath)
+{
+    const int limit { m_limits.value(repositoryPath) };
+    if (limit <= 0)
+        return;
+
+    // 广度优先，配额不足时保留浅层目录
+    QStringList pending { directory };
+    while (!pending.isEmpty()) {
+        if (m_repositoryWatches.value(repositoryPath).size() >= limit) {
+            if (!m_truncated.contains(repositoryPath)) {
+                qWarning() << "WARNING: [GitInotifyWatcher] Reached directory watch limit (" << limit
+                           << ") for repository:" << repositoryPath;
+                m_truncated.insert(repositoryPath);
+                reportUsage(repositoryPath);
+            }
+            return;
+        }
+
+        const QString current { pending.takeFirst() };
+        if (addWatch(current, repositoryPath, WatchKind::WorkTree) < 0)
+            continue;
+
+        const QStringList &children { QDir(current).entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::NoSymLinks) };
+        for (const QString &child : children) {
+            const QString &childPath { current + '/' + child };
+            if (!shouldWatchDirectory(childPath, repositoryPath))
+                continue;
+            // 嵌套仓库由它自己的监控负责
+            if (QFileInfo::exists(childPath + "/.git"))
+                continue;
+            pending.append(childPath);
+        }
+    }
+}
+
+void GitInotifyWatcher::removeWorkTree(const QString &repositoryPath)
+{
+    const QSet<int> watches { m_repositoryWatches.value(repositoryPath) };
+    for (int wd : watches) {
+        if (m_watches.value(wd).kind == WatchKind::WorkTree)
+            removeWatch(wd);
+    }
+    m_truncated.remove(repositoryPath);
+}
+
+void GitInotifyWatcher::reportUsage(const QString &repositoryPath)
+{
+    // 只监控元数据时的用量对分配没有意义
+    if (m_limits.value(repositoryPath) <= 0)
+        return;
+    emit repositoryWatchUsage(repositoryPath, m_repositoryWatches.value(repositoryPath).size(),
+                              !m_truncated.contains(repositoryPath));
+}
+
+int GitInotifyWatcher::addWatch(const QString &directory, const QString &repositoryPath, WatchKind kind)
+{
+    auto existing = m_directoryWatches.constFind(directory);
+    if (existing != m_directoryWatches.constEnd())
+        return existing.value();
+
+    const int wd { ::inotify_add_watch(m_fd, QFile::encodeName(directory).constData(), kDirectoryMask) };
+    if (wd < 0) {
+        if (errno == ENOSPC)
+            qWarning() << "WARNING: [GitInotifyWatcher] inotify watch limit reached, see fs.inotify.max_user_watches";
+        return -1;
+    }
+
+    // 同一个 inode 已经以其他路径被监控（bind mount 等），保留原来的记录
+    if (m_watches.contains(wd))
+        return wd;
+
+    m_watches.insert(wd, Watch { directory, repositoryPath, kind });
+    m_directoryWatches.insert(directory, wd);
+    m_repositoryWatches[repositoryPath].insert(wd);
+    return wd;
+}
+
+void GitInotifyWatcher::removeWatch(int wd)
+{
+    auto it = m_watches.find(wd);
+    if (it == m_watches.end())
+        return;
+
+    ::inotify_rm_watch(m_fd, wd);
+    m_directoryWatches.remove(it->path);
+    auto repositoryWatches = m_repositoryWatches.find(it->repositoryPath);
+    if (repositoryWatches != m_repositoryWatches.end())
+        repositoryWatches->remove(wd);
+    m_watches.erase(it);
+}
+
+void GitInotifyWatcher::removeTree(const QString &directory)
+{
+    const QString &prefix { directory + '/' };
+    QList<int> watches;
+    for (auto it = m_directoryWatches.cbegin(); it != m_directoryWatches.cend(); ++it) {
+        if (it.key() == directory || it.key().startsWith(prefix))
+            watches.append(it.value());
+    }
+    for (int wd : watches)
+        removeWatch(wd);
+}
+
+void GitInotifyWatcher::rescan()
+{
+    // 溢出时 IN_IGNORED 也可能一并丢失，记录中可能残留已删除目录的 wd，addWatch 会直接复用它们。
+    // 重新遍历前逐个用 inotify_add_watch 核对：路径已不存在或已换成新 inode 的记录视为失效并清除
+    qWarning() << "WARNING: [GitInotifyWatcher] Event queue overflowed, rescanning" << m_repositories.size() << "repositories";
+    QList<int> staleWatches;
+    for (auto it = m_watches.cbegin(); it != m_watches.cend(); ++it) {
+        const int wd { ::inotify_add_watch(m_fd, QFile::encodeName(it->path).constData(), kDirectoryMask) };
+        if (wd == it.key())
+            continue;
+        staleWatches.append(it.key());
+        // 新 inode 的监控交给下面的重新遍历按预算决定是否保留
+        if (wd >= 0 && !m_watches.contains(wd))
+            ::inotify_rm_watch(m_fd, wd);
+    }
+    for (int wd : staleWatches)
+        removeWatch(wd);
+    if (!staleWatches.isEmpty())
+        qInfo() << "INFO: [GitInotifyWatcher] Dropped" << staleWatches.size() << "stale watches after overflow";
+
+    for (const QString &repositoryPath : std::as_const(m_repositories)) {
+        GitRepositoryResolver::instance().invalidate(repositoryPath);
+        watchRepository(repositoryPath);
+        reportUsage(repositoryPath);
+        emit repositoryChanged(repositoryPath, GitFileSystemWatcher::AllChanges, {});
+    }
+}
+
+void GitInotifyWatcher::onReadyRead()
+{
+    QHash<QString, QSet<QString>> changedPaths;   // 仓库 -> 变化的工作区路径
+    QHash<QString, int> changes;   // 仓库 -> ChangeKind 组合
+    QSet<QString> fullWorkTrees;   // 整个工作区都需要检索的仓库
+    QHash<uint32_t, QPair<QString, QString>> movedFrom;   // cookie -> (仓库, 原路径)
+    QHash<QString, QPair<QStringList, QStringList>> moves;   // 仓库 -> (原路径, 新路径)
+    bool overflowed { false };
+
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    for (;;) {
+        const ssize_t length { ::read(m_fd, buffer, sizeof(buffer)) };
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0)
+            break;
+
+        for (const char *cursor = buffer; cursor < buffer + length;) {
+            const auto *event { reinterpret_cast<const struct inotify_event *>(cursor) };
+            cursor += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflowed = true;
+                continue;
+            }
+
+            auto it = m_watches.constFind(event->wd);
+            if (it == m_watches.constEnd())
+                continue;
+            const Watch watch { it.value() };
+
+            // 目录本身被删除或移走，监控已失效
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                if (event->mask & (IN_IGNORED | IN_MOVE_SELF))
+                    removeWatch(event->wd);
+                GitRepositoryResolver::instance().invalidate(watch.path);
+                if (watch.kind == WatchKind::GitDirectory) {
+                    changes[watch.repositoryPath] |= GitFileSystemWatcher::AllChanges;
+                } else if (watch.kind == WatchKind::RemoteRefs) {
+                    changes[watch.repositoryPath] |= GitFileSystemWatcher::FetchChange;
+                } else if (watch.kind == WatchKind::Refs) {
+                    changes[watch.repositoryPath] |= GitFileSystemWatcher::RefChange;
+                } else {
+                    changes[watch.repositoryPath] |= GitFileSystemWatcher::WorkTreeChange;
+                    if (watch.path == watch.repositoryPath)
+                        fullWorkTrees.insert(watch.repositoryPath);
+                    else
+                        changedPaths[watch.repositoryPath].insert(watch.path);
+                }
+                continue;
+            }
+
+            const QString &name { event->len > 0 ? QFile::decodeName(event->name) : QString() };
+            // git 以 "写 .lock 再改名" 的方式更新文件，.lock 本身的事件没有意义
+            if (watch.kind != WatchKind::WorkTree && name.endsWith(QLatin1String(".lock")))
+                continue;
+
+            if (watch.kind == WatchKind::Refs || watch.kind == WatchKind::RemoteRefs) {
+                const WatchKind kind { childRefsKind(watch.path, name, watch.kind) };
+                if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+                    watchRefs(watch.path + '/' + name, watch.repositoryPath, kind);
+                changes[watch.repositoryPath] |= kind == WatchKind::RemoteRefs ? GitFileSystemWatcher::FetchChange
+                                                                              : GitFileSystemWatcher::RefChange;
+                continue;
+            }
+
+            if (watch.kind == WatchKind::GitDirectory) {
+                const int kind { GitFileSystemWatcher::classifyMetadata(name) };
+                if (kind)
+                    changes[watch.repositoryPath] |= kind;
+                continue;
+            }
+
+            const QString &path { watch.path + '/' + name };
+            // 同一次改名的两个事件 cookie 相同，且总是先 FROM 后 TO；移入、移出工作区的只按增删处理
+            if (event->mask & IN_MOVED_FROM) {
+                movedFrom.insert(event->cookie, qMakePair(watch.repositoryPath, path));
+            } else if (event->mask & IN_MOVED_TO) {
+                const QPair<QString, QString> &source { movedFrom.take(event->cookie) };
+                if (source.first == watch.repositoryPath) {
+                    auto &repositoryMoves { moves[watch.repositoryPath] };
+                    repositoryMoves.first.append(source.second);
+                    repositoryMoves.second.append(path);
+                }
+            }
+
+            if (name == QLatin1String(".git")) {
+                // 目录中出现或删除了 .git（git init/clone 建的是目录，worktree/submodule 的是文件），
+                // 该目录及其下所有目录的仓库归属随之改变
+                GitRepositoryResolver::instance().invalidate(watch.path);
+                if (watch.path != watch.repositoryPath && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    // 出现了嵌套仓库，它的工作区不再属于外层仓库
+                    removeTree(watch.path);
+                    reportUsage(watch.repositoryPath);
+                }
+                changes[watch.repositoryPath] |= GitFileSystemWatcher::WorkTreeChange;
+                if (watch.path == watch.repositoryPath)
+                    fullWorkTrees.insert(watch.repositoryPath);
+                else
+                    changedPaths[watch.repositoryPath].insert(watch.path);
+                continue;
+            }
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    if (shouldWatchDirectory(path, watch.repositoryPath) && !QFileInfo::exists(path + "/.git"))
+                        watchTree(path, watch.repositoryPath);
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    removeTree(path);
+                    GitIgnoreMatcher::instance().invalidate(path);
+                }
+                GitRepositoryResolver::instance().invalidate(path);
+            } else if (name == QLatin1String(".gitignore")) {
+                // 忽略规则变化影响所在目录下的所有路径
+                GitIgnoreMatcher::instance().invalidate(path);
+                changes[watch.repositoryPath] |= GitFileSystemWatcher::WorkTreeChange;
+                if (watch.path == watch.repositoryPath)
+                    fullWorkTrees.insert(watch.repositoryPath);
+                else
+                    changedPaths[watch.repositoryPath].insert(watch.path);
+                continue;
+            } else if ((event->mask & (IN_CLOSE_WRITE | IN_ATTRIB))
+                       && Global::Cache::instance().version(path) == Global::ItemVersion::IgnoredVersion) {
+                // 已发布为被忽略的文件，内容变化不影响状态（编译产物、编辑器临时文件），增删仍需刷新忽略标记；
+                // 只按规则判断会漏掉匹配规则但已被跟踪的文件
+                continue;
+            }
+
+            changes[watch.repositoryPath] |= GitFileSystemWatcher::WorkTreeChange;
+            changedPaths[watch.repositoryPath].insert(path);
+        }
+    }
+
+    if (overflowed) {
+        rescan();
+        return;
+    }
+
+    for (auto it = moves.cbegin(); it != moves.cend(); ++it)
+        emit pathsMoved(it.key(), it->first, it->second);
+
+    for (auto it = changes.cbegin(); it != changes.cend(); ++it) {
+        const bool fullWorkTree { fullWorkTrees.contains(it.key()) };
+        emit repositoryChanged(it.key(), it.value(), fullWorkTree ? QStringList() : changedPaths.value(it.key()).values());
+    }
+}
+
+bool GitInotifyWatcher::shouldWatchDirectory(const QString &path, const QString &repositoryPath)
+{
+    if (path.endsWith(QLatin1String("/.git")))
+        return false;
+    // 被忽略的目录内部的变化不需要监控，除非其中有被跟踪的文件（忽略规则对它们不起作用）
+    const QString &relativePath { path.mid(repositoryPath.size() + 1) };
+    return !GitIgnoreMatcher::instance().isIgnored(repositoryPath, relativePath, true)
+            || Utils::containsTrackedFiles(repositoryPath, relativePath);
+}
+
+GitInotifyWatcher::WatchKind GitInotifyWatcher::childRefsKind(const QString &directory, const QString &name, WatchKind kind)
+{
+    // refs 目录下的 remotes 子目录属于远程分支
+    if (kind == WatchKind::Refs && name == QLatin1String("remotes") && directory.endsWith(QLatin1String("/refs")))
+        return WatchKind::RemoteRefs;
+    return kind;
+}
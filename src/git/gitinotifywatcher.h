@@ -0,0 +1,130 @@
+#ifndef GITINOTIFYWATCHER_H
+#define GITINOTIFYWATCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+
+class QSocketNotifier;
+
+/**
+ * @brief 基于 inotify 的仓库监控后端
+ *
+ * 只监控目录：工作区目录递归监控（跳过 .git、嵌套仓库和被 gitignore 忽略的目录），
+ * 外加 git 目录本身与 refs 目录，文件的增删改都通过所在目录的事件得到，
+ * 不再需要为每个被跟踪文件单独添加监控。
+ *
+ * 工作区监控数受 GitWatchBudget 分配的配额限制，超出配额时按广度优先保留浅层目录，
+ * 并通过 repositoryWatchUsage() 报告，配额为 0 时只监控元数据。
+ *
+ * 运行在独立线程上，所有槽都应通过队列连接调用。
+ * 事件按 GitFileSystemWatcher::ChangeKind 分类，工作区事件带出变化的路径，同一仓库内的改名另外通过 pathsMoved() 报告；
+ * 事件队列溢出（IN_Q_OVERFLOW）时重新扫描所有仓库的目录并报告全部类别的变化。
+ */
+class GitInotifyWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit GitInotifyWatcher(QObject *parent = nullptr);
+    ~GitInotifyWatcher() override;
+
+    /**
+     * @brief inotify 是否可用，不可用时调用方应退回 QFileSystemWatcher
+     */
+    bool isValid() const { return m_fd >= 0; }
+
+public Q_SLOTS:
+    /**
+     * @brief 在监控线程中创建事件通知器，线程启动后调用一次
+     */
+    void initialize();
+
+    /**
+     * @brief 开始监控仓库
+     * @param repositoryPath 仓库路径
+     * @param limit 监控数配额（含元数据），0 表示只监控元数据
+     */
+    void addRepository(const QString &repositoryPath, int limit);
+    void removeRepository(const QString &repositoryPath);
+
+    /**
+     * @brief 调整仓库的监控数配额，超出新配额时收回工作区监控后重新按配额监控
+     * @param repositoryPath 仓库路径
+     * @param limit 监控数配额（含元数据），0 表示只监控元数据
+     */
+    void setRepositoryLimit(const QString &repositoryPath, int limit);
+
+Q_SIGNALS:
+    /**
+     * @brief 仓库中发生了需要重新检索的变化（一次读取内的多个事件只发一次）
+     * @param repositoryPath 仓库路径
+     * @param changes GitFileSystemWatcher::ChangeKind 组合
+     * @param paths 变化的工作区绝对路径；含 WorkTreeChange 而路径为空表示整个工作区
+     */
+    void repositoryChanged(const QString &repositoryPath, int changes, const QStringList &paths);
+
+    /**
+     * @brief 仓库的监控数发生了需要重新分配配额的变化
+     * @param repositoryPath 仓库路径
+     * @param used 实际监控数
+     * @param complete 配额内是否容纳了整个工作区
+     */
+    void repositoryWatchUsage(const QString &repositoryPath, int used, bool complete);
+
+    /**
+     * @brief 工作区内的文件或目录被改名/移动（IN_MOVED_FROM 与 IN_MOVED_TO 按 cookie 配对）
+     *
+     * 先于同一批事件的 repositoryChanged() 发出，两端路径仍会出现在 repositoryChanged() 中用于确认。
+     *
+     * @param repositoryPath 仓库路径
+     * @param sources 原绝对路径
+     * @param targets 新绝对路径，与 sources 按下标对应
+     */
+    void pathsMoved(const QString &repositoryPath, const QStringList &sources, const QStringList &targets);
+
+private Q_SLOTS:
+    void onReadyRead();
+
+private:
+    enum class WatchKind {
+        WorkTree,   ///< 工作区目录
+        GitDirectory,   ///< git 目录（及 worktree 的共享目录）本身
+        Refs,   ///< refs 下除 remotes 外的目录
+        RemoteRefs   ///< refs/remotes 及其子目录
+    };
+
+    struct Watch
+    {
+        QString path;   ///< 目录绝对路径
+        QString repositoryPath;
+        WatchKind kind { WatchKind::WorkTree };
+    };
+
+    void watchRepository(const QString &repositoryPath);
+    void watchTree(const QString &directory, const QString &repositoryPath);
+    void removeWorkTree(const QString &repositoryPath);
+    void reportUsage(const QString &repositoryPath);
+    void watchRefs(const QString &directory, const QString &repositoryPath, WatchKind kind);
+    int addWatch(const QString &directory, const QString &repositoryPath, WatchKind kind);
+    void removeWatch(int wd);
+    void removeTree(const QString &directory);
+    void rescan();
+
+    static bool shouldWatchDirectory(const QString &path, const QString &repositoryPath);
+    static WatchKind childRefsKind(const QString &directory, const QString &name, WatchKind kind);
+
+    int m_fd { -1 };
+    QSocketNotifier *m_notifier { nullptr };
+
+    QSet<QString> m_repositories;
+    QHash<int, Watch> m_watches;   ///< wd -> 监控目录
+    QHash<QString, int> m_directoryWatches;   ///< 目录 -> wd
+    QHash<QString, QSet<int>> m_repositoryWatches;   ///< 仓库 -> wd 集合
+    QHash<QString, int> m_limits;   ///< 仓库 -> 监控数配额
+    QSet<QString> m_truncated;   ///< 因配额不足没有完整监控工作区的仓库
+};
+
+#endif   // GITINOTIFYWATCHER_H
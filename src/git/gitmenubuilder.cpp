@@ -1,6 +1,7 @@
 #include "gitmenubuilder.h"
 #include "gitoperationservice.h"
 #include "utils.h"
+#include "gitrepositoryinfo.h"
 
 #include <QFileInfo>
 
@@ -372,7 +373,16 @@ void GitMenuBuilder::addBranchOperationMenuItems(DFMEXT::DFMExtMenu *menu, const
 
 void GitMenuBuilder::addSyncOperationMenuItems(DFMEXT::DFMExtMenu *menu, const QString &repositoryPath)
 {
-    const QString branchName = Utils::getBranchName(repositoryPath);
+    QString branchName = Utils::getBranchName(repositoryPath);
+
+    // 上游跟踪信息来自缓存，没有缓存时不显示
+    GitRepositoryInfo info;
+    if (GitRepositoryInfoStore::instance().info(repositoryPath, &info) && !info.upstream.isEmpty()) {
+        if (info.upstreamGone)
+            branchName += QString("\nUpstream: %1 (gone)").arg(info.upstream);
+        else
+            branchName += QString("\nUpstream: %1 (ahead %2, behind %3)").arg(info.upstream).arg(info.ahead).arg(info.behind);
+    }
 
     // Git Pull - 使用高级对话框
     auto pullAction = m_proxy->createAction();
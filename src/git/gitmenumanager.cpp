@@ -95,10 +95,6 @@ bool GitMenuManager::buildEmptyAreaMenu(DFMEXT::DFMExtMenu *main,
     }
 
     const QString dirPath = QString::fromStdString(currentPath);
-    if (!Utils::isInsideRepositoryDir(dirPath)) {
-        return false;
-    }
-
     const QString repositoryPath = Utils::repositoryBaseDir(dirPath);
     if (repositoryPath.isEmpty()) {
         return false;
@@ -0,0 +1,88 @@
+#ifndef GITPORCELAINPARSER_H
+#define GITPORCELAINPARSER_H
+
+#include <cstring>
+#include <string_view>
+
+#include <QByteArray>
+
+/**
+ * @brief `git status --porcelain -z` 输出的分块解析器
+ *
+ * 调用方按块喂入原始字节，解析器用 memchr（glibc 中为 SIMD 实现）查找 NUL 分隔符，
+ * 以 string_view 形式直接在输入块上交出 X/Y 状态码和路径，不做解码和拷贝。
+ * 只有跨越两个块的记录才会暂存到内部缓冲区。路径长度不受限制。
+ *
+ * 记录格式：`XY <path>\0`，重命名/复制（X 为 R 或 C）之后紧跟一条 `<orig path>\0`。
+ */
+class GitPorcelainParser
+{
+public:
+    /**
+     * @brief 喂入一块输出
+     * @param data 数据起始地址
+     * @param size 数据长度
+     * @param handler 回调 `void(char X, char Y, std::string_view path)`，path 只在回调期间有效
+     */
+    template<typename Handler>
+    void feed(const char *data, std::size_t size, Handler &&handler)
+    {
+        const char *cursor { data };
+        const char *end { data + size };
+        while (cursor < end) {
+            const char *terminator { static_cast<const char *>(std::memchr(cursor, '\0', static_cast<std::size_t>(end - cursor))) };
+            if (!terminator) {
+                m_pending.append(cursor, static_cast<int>(end - cursor));
+                return;
+            }
+
+            if (m_pending.isEmpty()) {
+                handleRecord(std::string_view(cursor, static_cast<std::size_t>(terminator - cursor)), handler);
+            } else {
+                m_pending.append(cursor, static_cast<int>(terminator - cursor));
+                handleRecord(std::string_view(m_pending.constData(), static_cast<std::size_t>(m_pending.size())), handler);
+                m_pending.clear();
+            }
+            cursor = terminator + 1;
+        }
+    }
+
+    /**
+     * @brief 输出结束时调用，处理没有以 NUL 结尾的最后一条记录
+     */
+    template<typename Handler>
+    void finish(Handler &&handler)
+    {
+        if (!m_pending.isEmpty()) {
+            handleRecord(std::string_view(m_pending.constData(), static_cast<std::size_t>(m_pending.size())), handler);
+            m_pending.clear();
+        }
+        m_expectOriginalPath = false;
+    }
+
+    std::size_t recordCount() const { return m_recordCount; }
+
+private:
+    template<typename Handler>
+    void handleRecord(std::string_view record, Handler &handler)
+    {
+        if (m_expectOriginalPath) {   // 重命名/复制的原路径，不单独记录
+            m_expectOriginalPath = false;
+            return;
+        }
+        if (record.size() < 4 || record[2] != ' ')
+            return;
+
+        const char X { record[0] };
+        const char Y { record[1] };
+        m_expectOriginalPath = (X == 'R' || X == 'C');
+        ++m_recordCount;
+        handler(X, Y, record.substr(3));
+    }
+
+    QByteArray m_pending;
+    bool m_expectOriginalPath { false };
+    std::size_t m_recordCount { 0 };
+};
+
+#endif   // GITPORCELAINPARSER_H
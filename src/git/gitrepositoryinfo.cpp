@@ -0,0 +1,126 @@
+#include "gitrepositoryinfo.h"
+#include "utils.h"
+
+#include <QProcess>
+#include <QRegularExpression>
+#include <QDebug>
+
+GitRepositoryInfoStore &GitRepositoryInfoStore::instance()
+{
+    static GitRepositoryInfoStore store;
+    return store;
+}
+
+bool GitRepositoryInfoStore::info(const QString &repositoryPath, GitRepositoryInfo *info) const
+{
+    QReadLocker locker(&m_lock);
+    auto it = m_infos.constFind(repositoryPath);
+    if (it == m_infos.constEnd())
+        return false;
+    *info = it.value();
+    return true;
+}
+
+GitRepositoryInfo GitRepositoryInfoStore::refreshBranch(const QString &repositoryPath)
+{
+    GitRepositoryInfo info;
+    if (!readBranch(repositoryPath, &info)) {
+        // HEAD 不可读：仓库已被删除或移走，不保留空记录
+        remove(repositoryPath);
+        return info;
+    }
+    readTracking(repositoryPath, &info);
+
+    QWriteLocker locker(&m_lock);
+    m_infos.insert(repositoryPath, info);
+    return info;
+}
+
+GitRepositoryInfo GitRepositoryInfoStore::refreshTracking(const QString &repositoryPath)
+{
+    GitRepositoryInfo info;
+    if (!this->info(repositoryPath, &info))
+        return refreshBranch(repositoryPath);
+
+    readTracking(repositoryPath, &info);
+
+    QWriteLocker locker(&m_lock);
+    // 期间分支已被 refreshBranch() 更新时保留新的结果
+    auto it = m_infos.find(repositoryPath);
+    if (it != m_infos.end() && it->branch == info.branch && it->detached == info.detached)
+        it.value() = info;
+    return info;
+}
+
+void GitRepositoryInfoStore::remove(const QString &repositoryPath)
+{
+    QWriteLocker locker(&m_lock);
+    m_infos.remove(repositoryPath);
+}
+
+bool GitRepositoryInfoStore::readBranch(const QString &repositoryPath, GitRepositoryInfo *info)
+{
+    // 直接读取 HEAD，不启动 git
+    const Utils::RepositoryFingerprint &fingerprint { Utils::readRepositoryFingerprint(repositoryPath) };
+    if (fingerprint.head.startsWith("ref: refs/heads/")) {
+        info->branch = QString::fromUtf8(fingerprint.head.mid(static_cast<int>(qstrlen("ref: refs/heads/"))));
+        info->detached = false;
+        return true;
+    }
+
+    if (fingerprint.headOid.isEmpty())
+        return false;
+    info->branch = QString::fromLatin1(fingerprint.headOid.left(7));
+    info->detached = true;
+    return true;
+}
+
+void GitRepositoryInfoStore::readTracking(const QString &repositoryPath, GitRepositoryInfo *info)
+{
+    info->upstream.clear();
+    info->ahead = 0;
+    info->behind = 0;
+    info->upstreamGone = false;
+    if (info->detached || info->branch.isEmpty())
+        return;
+
+    // 一次得到上游名与领先/落后计数，输出形如 "origin/master\0ahead 1, behind 2"
+    QProcess process;
+    process.setWorkingDirectory(repositoryPath);
+    process.start("git", { "for-each-ref", "--count=1", "--format=%(upstream:short)%00%(upstream:track,nobracket)",
+                           "refs/heads/" + info->branch });
+    if (!process.waitForFinished(TRACKING_TIMEOUT_MS)) {
+        // 不能让卡住的 git（锁等待、网络文件系统等）随 QProcess 析构阻塞工作线程
+        process.kill();
+        process.waitForFinished();
+        qWarning() << "WARNING: [GitRepositoryInfoStore] Timed out reading upstream of branch:" << info->branch
+                   << "in repository:" << repositoryPath;
+        return;
+    }
+    if (process.exitCode() != 0) {
+        qWarning() << "WARNING: [GitRepositoryInfoStore] Failed to read upstream of branch:" << info->branch
+                   << "in repository:" << repositoryPath;
+        return;
+    }
+
+    const QByteArray &output { process.readAllStandardOutput().trimmed() };
+    const int separator { output.indexOf('\0') };
+    if (separator <= 0)
+        return;
+
+    info->upstream = QString::fromUtf8(output.left(separator));
+    const QString &track { QString::fromUtf8(output.mid(separator + 1)) };
+    if (track == QLatin1String("gone")) {
+        info->upstreamGone = true;
+        return;
+    }
+
+    static const QRegularExpression aheadPattern { QStringLiteral("ahead (\\d+)") };
+    static const QRegularExpression behindPattern { QStringLiteral("behind (\\d+)") };
+    const QRegularExpressionMatch &ahead { aheadPattern.match(track) };
+    if (ahead.hasMatch())
+        info->ahead = ahead.captured(1).toInt();
+    const QRegularExpressionMatch &behind { behindPattern.match(track) };
+    if (behind.hasMatch())
+        info->behind = behind.captured(1).toInt();
+}
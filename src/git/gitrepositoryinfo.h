@@ -0,0 +1,76 @@
+#ifndef GITREPOSITORYINFO_H
+#define GITREPOSITORYINFO_H
+
+#include <QString>
+#include <QHash>
+#include <QReadWriteLock>
+
+/**
+ * @brief 仓库的分支与上游跟踪信息
+ */
+struct GitRepositoryInfo
+{
+    QString branch;   ///< 当前分支名，分离 HEAD 时为缩写的提交哈希
+    bool detached { false };
+    QString upstream;   ///< 上游分支（如 origin/master），未设置时为空
+    int ahead { 0 };   ///< 领先上游的提交数
+    int behind { 0 };   ///< 落后上游的提交数
+    bool upstreamGone { false };   ///< 上游分支已被删除
+};
+
+/**
+ * @brief 仓库分支信息缓存
+ *
+ * 由状态检索调度器在引用、配置或 fetch 变化时刷新，菜单等处直接读取，
+ * 不必每次都启动 git。刷新分为两种：
+ * - 引用变化：重新读取 HEAD 得到分支，并刷新上游与领先/落后计数；
+ * - fetch：分支不变，只刷新领先/落后计数。
+ *
+ * 线程安全，可在任意线程调用。
+ */
+class GitRepositoryInfoStore
+{
+public:
+    static GitRepositoryInfoStore &instance();
+
+    /**
+     * @brief 读取缓存的仓库信息
+     * @param repositoryPath 仓库根目录
+     * @param info 输出
+     * @return 没有缓存时返回 false
+     */
+    bool info(const QString &repositoryPath, GitRepositoryInfo *info) const;
+
+    /**
+     * @brief 读取分支并刷新上游信息（会启动一次 git for-each-ref）
+     * @param repositoryPath 仓库根目录
+     * @return 新的仓库信息
+     */
+    GitRepositoryInfo refreshBranch(const QString &repositoryPath);
+
+    /**
+     * @brief 只刷新上游与领先/落后计数，分支沿用缓存，没有缓存时等同于 refreshBranch()
+     * @param repositoryPath 仓库根目录
+     * @return 新的仓库信息
+     */
+    GitRepositoryInfo refreshTracking(const QString &repositoryPath);
+
+    /**
+     * @brief 丢弃仓库的缓存信息（仓库不再被监控或已被删除时调用）
+     * @param repositoryPath 仓库根目录
+     */
+    void remove(const QString &repositoryPath);
+
+private:
+    GitRepositoryInfoStore() = default;
+
+    static bool readBranch(const QString &repositoryPath, GitRepositoryInfo *info);
+    static void readTracking(const QString &repositoryPath, GitRepositoryInfo *info);
+
+    mutable QReadWriteLock m_lock;
+    QHash<QString, GitRepositoryInfo> m_infos;   ///< repository path -> 分支信息
+
+    static constexpr int TRACKING_TIMEOUT_MS = 3000;
+};
+
+#endif   // GITREPOSITORYINFO_H
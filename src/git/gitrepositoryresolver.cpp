@@ -0,0 +1,113 @@
+#include "gitrepositoryresolver.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QStringList>
+#include <QDebug>
+
+GitRepositoryResolver &GitRepositoryResolver::instance()
+{
+    static GitRepositoryResolver resolver;
+    return resolver;
+}
+
+QString GitRepositoryResolver::repositoryRoot(const QString &path)
+{
+    if (path.isEmpty())
+        return QString();
+
+    const QFileInfo info(path);
+    QString directory { QDir::cleanPath(info.isDir() ? info.absoluteFilePath() : info.absolutePath()) };
+    if (!QFileInfo(directory).isDir())
+        return QString();
+
+    const qint64 now { QDateTime::currentMSecsSinceEpoch() };
+    QString root;
+    // 向上查找，记录经过的目录，命中后一并写入缓存
+    QStringList visited;
+    while (!lookup(directory, now, &root)) {
+        visited.append(directory);
+
+        // .git 目录内部不属于工作区
+        if (directory.endsWith(QLatin1String("/.git")) || directory.contains(QLatin1String("/.git/"))) {
+            root.clear();
+            break;
+        }
+
+        if (hasGitMarker(directory)) {
+            root = directory;
+            break;
+        }
+
+        const int slash { directory.lastIndexOf('/') };
+        if (slash < 0 || directory == QLatin1String("/")) {
+            root.clear();
+            break;
+        }
+        directory = slash == 0 ? QStringLiteral("/") : directory.left(slash);
+    }
+
+    if (visited.isEmpty())
+        return root;
+
+    QWriteLocker locker(&m_lock);
+    if (m_entries.size() + visited.size() > MAX_ENTRIES)
+        m_entries.clear();
+    for (const QString &dir : visited)
+        m_entries.insert(dir, Entry { root, now });
+
+    return root;
+}
+
+void GitRepositoryResolver::invalidate(const QString &path)
+{
+    const QString &directory { QDir::cleanPath(path) };
+    const QString &prefix { directory.endsWith('/') ? directory : directory + '/' };
+
+    QWriteLocker locker(&m_lock);
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it.key() == directory || it.key().startsWith(prefix))
+            it = m_entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+void GitRepositoryResolver::clear()
+{
+    QWriteLocker locker(&m_lock);
+    m_entries.clear();
+}
+
+bool GitRepositoryResolver::lookup(const QString &directory, qint64 now, QString *root) const
+{
+    QReadLocker locker(&m_lock);
+    auto it = m_entries.constFind(directory);
+    if (it == m_entries.constEnd())
+        return false;
+
+    // 否定结果可能因为 git init/clone 而过期，肯定结果可能因为仓库被删除或移走而过期
+    if (now - it->checkedAt > (it->root.isEmpty() ? NEGATIVE_TTL_MS : POSITIVE_TTL_MS))
+        return false;
+
+    *root = it->root;
+    return true;
+}
+
+bool GitRepositoryResolver::hasGitMarker(const QString &directory)
+{
+    const QString &dotGit { directory == QLatin1String("/") ? QStringLiteral("/.git") : directory + QLatin1String("/.git") };
+    const QFileInfo info(dotGit);
+    if (info.isDir())
+        return QFileInfo::exists(dotGit + QLatin1String("/HEAD"));
+    if (!info.isFile())
+        return false;
+
+    // worktree 和 submodule 中 .git 是一个文件："gitdir: <path>"
+    QFile file(dotGit);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    return file.read(8).startsWith("gitdir:");
+}
@@ -0,0 +1,62 @@
+#ifndef GITREPOSITORYRESOLVER_H
+#define GITREPOSITORYRESOLVER_H
+
+#include <QString>
+#include <QHash>
+#include <QReadWriteLock>
+
+/**
+ * @brief 不启动 git 进程的仓库根目录解析器
+ *
+ * 从给定目录逐级向上查找 `.git` 目录（需包含 HEAD）或以 "gitdir:" 开头的 `.git` 文件
+ * （worktree/submodule），语义与 `git rev-parse --show-toplevel` 一致，
+ * 位于 `.git` 目录内部的路径不属于任何工作区。
+ *
+ * 结果按目录缓存，找到与找不到都会缓存，查找路径上经过的每一级目录一并写入。
+ * 仓库内的目录变化由文件监控器调用 invalidate() 失效；
+ * 仓库外的否定结果监控不到，只保留 NEGATIVE_TTL_MS。只监控元数据的仓库看不到根目录下
+ * `.git` 的删除或移动，肯定结果也只保留 POSITIVE_TTL_MS，过期后重新逐级查找。
+ *
+ * 线程安全，可在任意线程调用。
+ */
+class GitRepositoryResolver
+{
+public:
+    static GitRepositoryResolver &instance();
+
+    /**
+     * @brief 解析路径所属仓库的根目录
+     * @param path 目录或文件的绝对路径，文件按其所在目录解析
+     * @return 仓库根目录，不在任何仓库工作区内返回空字符串
+     */
+    QString repositoryRoot(const QString &path);
+
+    /**
+     * @brief 使 path 及其下所有目录的缓存失效（目录新建/删除了 .git 时调用）
+     * @param path 发生变化的目录
+     */
+    void invalidate(const QString &path);
+
+    void clear();
+
+private:
+    GitRepositoryResolver() = default;
+
+    struct Entry
+    {
+        QString root;   ///< 为空表示不在仓库内
+        qint64 checkedAt { 0 };   ///< 检查时间（毫秒）
+    };
+
+    bool lookup(const QString &directory, qint64 now, QString *root) const;
+    static bool hasGitMarker(const QString &directory);
+
+    mutable QReadWriteLock m_lock;
+    QHash<QString, Entry> m_entries;   ///< 目录 -> 所属仓库根目录
+
+    static constexpr qint64 NEGATIVE_TTL_MS = 5000;   ///< 否定结果的有效期
+    static constexpr qint64 POSITIVE_TTL_MS = 30000;   ///< 肯定结果的有效期
+    static constexpr int MAX_ENTRIES = 8192;   ///< 超过后整体清空
+};
+
+#endif   // GITREPOSITORYRESOLVER_H
@@ -0,0 +1,243 @@
+#include "gitsnapshotstore.h"
+#include "utils.h"
+
+#include <array>
+#include <cstring>
+
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QDebug>
+
+namespace {
+
+constexpr char kSnapshotMagic[8] = { 'D', 'F', 'M', 'G', 'I', 'T', 'S', '1' };
+constexpr quint32 kSnapshotFormatVersion = 2;
+
+// 文件头之后依次为：键、仓库路径、对齐填充、条目数组、字符串池；索引在加载时重建
+struct SnapshotHeader
+{
+    char magic[8];
+    quint32 formatVersion;
+    quint32 entrySize;
+    quint32 keyBytes;
+    quint32 pathBytes;
+    quint64 entryCount;
+    quint64 arenaBytes;
+    quint32 payloadChecksum;   // 文件头之后全部内容的 CRC-32
+    quint32 reserved;
+};
+
+constexpr std::array<quint32, 256> makeCrcTable()
+{
+    std::array<quint32, 256> table {};
+    for (quint32 i = 0; i < 256; ++i) {
+        quint32 crc { i };
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        table[i] = crc;
+    }
+    return table;
+}
+
+// CRC-32（IEEE 802.3），按段累加：crc 初值为 0，返回值可作为下一段的 crc
+quint32 crc32(quint32 crc, const char *data, quint64 size)
+{
+    static constexpr std::array<quint32, 256> kTable { makeCrcTable() };
+    crc = ~crc;
+    for (quint64 i = 0; i < size; ++i)
+        crc = kTable[(crc ^ static_cast<uchar>(data[i])) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline quint64 alignedOffset(quint64 offset)
+{
+    return (offset + 7) & ~quint64(7);
+}
+
+bool readHeader(const uchar *data, qint64 size, SnapshotHeader *header)
+{
+    if (size < static_cast<qint64>(sizeof(SnapshotHeader)))
+        return false;
+    std::memcpy(header, data, sizeof(SnapshotHeader));
+    return std::memcmp(header->magic, kSnapshotMagic, sizeof(kSnapshotMagic)) == 0
+            && header->formatVersion == kSnapshotFormatVersion
+            && header->entrySize == Global::StatusTable::entrySize();
+}
+
+}   // namespace
+
+QByteArray GitSnapshotStore::repositoryKey(const QString &repositoryPath)
+{
+    const QByteArray &indexChecksum { Utils::readIndexChecksum(repositoryPath) };
+    const QByteArray &headOid { Utils::readHeadOid(repositoryPath) };
+    if (indexChecksum.isEmpty() && headOid.isEmpty())
+        return QByteArray();
+    return indexChecksum + ':' + headOid;
+}
+
+bool GitSnapshotStore::save(const Global::RepositorySnapshot &snapshot)
+{
+    const QString &repositoryPath { snapshot.repositoryPath() };
+    const QByteArray &key { repositoryKey(repositoryPath) };
+    if (key.isEmpty())
+        return false;
+
+    if (!QDir().mkpath(storeDirectory())) {
+        qWarning() << "WARNING: [GitSnapshotStore] Failed to create snapshot directory:" << storeDirectory();
+        return false;
+    }
+
+    const auto &table { snapshot.compactedTable() };
+    const Global::StatusTable::RawLayout &layout { table->rawLayout() };
+    const QByteArray &path { repositoryPath.toUtf8() };
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+    header.formatVersion = kSnapshotFormatVersion;
+    header.entrySize = static_cast<quint32>(Global::StatusTable::entrySize());
+    header.keyBytes = static_cast<quint32>(key.size());
+    header.pathBytes = static_cast<quint32>(path.size());
+    header.entryCount = layout.entryCount;
+    header.arenaBytes = layout.arenaBytes;
+    header.reserved = 0;
+
+    QSaveFile file(snapshotFilePath(repositoryPath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "WARNING: [GitSnapshotStore] Failed to open snapshot file:" << file.fileName();
+        return false;
+    }
+
+    const quint64 payloadOffset { sizeof(SnapshotHeader) + header.keyBytes + header.pathBytes };
+    const QByteArray padding(static_cast<int>(alignedOffset(payloadOffset) - payloadOffset), '\0');
+    const char *entries { static_cast<const char *>(layout.entries) };
+    const quint64 entriesBytes { layout.entryCount * header.entrySize };
+
+    quint32 checksum { crc32(0, key.constData(), static_cast<quint64>(key.size())) };
+    checksum = crc32(checksum, path.constData(), static_cast<quint64>(path.size()));
+    checksum = crc32(checksum, padding.constData(), static_cast<quint64>(padding.size()));
+    checksum = crc32(checksum, entries, entriesBytes);
+    checksum = crc32(checksum, layout.arena, layout.arenaBytes);
+    header.payloadChecksum = checksum;
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(key);
+    file.write(path);
+    file.write(padding);
+    file.write(entries, static_cast<qint64>(entriesBytes));
+    file.write(layout.arena, static_cast<qint64>(layout.arenaBytes));
+
+    if (!file.commit()) {
+        qWarning() << "WARNING: [GitSnapshotStore] Failed to write snapshot for:" << repositoryPath;
+        return false;
+    }
+
+    qDebug() << "[GitSnapshotStore] Saved snapshot for:" << repositoryPath
+             << "entries:" << layout.entryCount << "key:" << key;
+    return true;
+}
+
+std::shared_ptr<const Global::StatusTable> GitSnapshotStore::load(const QString &repositoryPath,
+                                                                  const QByteArray &expectedKey)
+{
+    QFile file(snapshotFilePath(repositoryPath));
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    const qint64 size { file.size() };
+    const uchar *data { file.map(0, size) };
+    if (!data)
+        return nullptr;
+
+    SnapshotHeader header;
+    if (!readHeader(data, size, &header)) {
+        qWarning() << "WARNING: [GitSnapshotStore] Invalid snapshot file:" << file.fileName();
+        return nullptr;
+    }
+
+    // 先确认各段都落在文件范围内，再解释其中的数据
+    const quint64 keyOffset { sizeof(SnapshotHeader) };
+    const quint64 pathOffset { keyOffset + header.keyBytes };
+    const quint64 entriesOffset { alignedOffset(pathOffset + header.pathBytes) };
+    // 各段长度来自文件，先排除相加溢出的情况
+    if (header.entryCount > static_cast<quint64>(size) / header.entrySize
+        || header.arenaBytes > static_cast<quint64>(size)) {
+        qWarning() << "WARNING: [GitSnapshotStore] Truncated snapshot file:" << file.fileName();
+        return nullptr;
+    }
+    const quint64 arenaOffset { entriesOffset + header.entryCount * header.entrySize };
+    if (arenaOffset + header.arenaBytes != static_cast<quint64>(size)) {
+        qWarning() << "WARNING: [GitSnapshotStore] Truncated snapshot file:" << file.fileName();
+        return nullptr;
+    }
+
+    const QByteArray storedKey(reinterpret_cast<const char *>(data + keyOffset), static_cast<int>(header.keyBytes));
+    const QString &storedPath { QString::fromUtf8(reinterpret_cast<const char *>(data + pathOffset),
+                                                  static_cast<int>(header.pathBytes)) };
+    if (storedPath != repositoryPath)
+        return nullptr;
+    if (!expectedKey.isEmpty() && storedKey != expectedKey) {
+        qDebug() << "[GitSnapshotStore] Snapshot key mismatch for:" << repositoryPath
+                 << "stored:" << storedKey << "current:" << expectedKey;
+        return nullptr;
+    }
+
+    // 键匹配后才值得校验整个文件
+    const quint32 checksum { crc32(0, reinterpret_cast<const char *>(data + keyOffset),
+                                   static_cast<quint64>(size) - keyOffset) };
+    if (checksum != header.payloadChecksum) {
+        qWarning() << "WARNING: [GitSnapshotStore] Snapshot checksum mismatch:" << file.fileName();
+        return nullptr;
+    }
+
+    Global::StatusTable::RawLayout layout;
+    layout.entries = data + entriesOffset;
+    layout.entryCount = header.entryCount;
+    layout.arena = reinterpret_cast<const char *>(data + arenaOffset);
+    layout.arenaBytes = header.arenaBytes;
+
+    auto table { std::make_shared<Global::StatusTable>() };
+    if (!Global::StatusTable::fromRawLayout(layout, table.get())) {
+        qWarning() << "WARNING: [GitSnapshotStore] Corrupted snapshot file:" << file.fileName();
+        return nullptr;
+    }
+
+    qDebug() << "[GitSnapshotStore] Loaded snapshot for:" << repositoryPath << "entries:" << table->size();
+    return table;
+}
+
+void GitSnapshotStore::prune(int maxCount, int maxAgeDays)
+{
+    const QDir dir(storeDirectory());
+    // 按修改时间从新到旧
+    const QFileInfoList &files { dir.entryInfoList({ "*.snapshot" }, QDir::Files, QDir::Time) };
+    const QDateTime &expiry { QDateTime::currentDateTime().addDays(-maxAgeDays) };
+
+    int removed { 0 };
+    for (int i = 0; i < files.size(); ++i) {
+        const QFileInfo &info { files.at(i) };
+        if (i < maxCount && info.lastModified() >= expiry)
+            continue;
+        if (QFile::remove(info.absoluteFilePath()))
+            ++removed;
+    }
+
+    if (removed > 0)
+        qInfo() << "INFO: [GitSnapshotStore] Pruned" << removed << "snapshots, kept" << files.size() - removed;
+}
+
+QString GitSnapshotStore::storeDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+            + "/dde-file-manager-vcs-plugin/git-status";
+}
+
+QString GitSnapshotStore::snapshotFilePath(const QString &repositoryPath)
+{
+    const QByteArray &hash { QCryptographicHash::hash(repositoryPath.toUtf8(), QCryptographicHash::Sha1).toHex() };
+    return storeDirectory() + "/" + QString::fromLatin1(hash) + ".snapshot";
+}
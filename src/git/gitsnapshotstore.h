@@ -0,0 +1,57 @@
+#ifndef GITSNAPSHOTSTORE_H
+#define GITSNAPSHOTSTORE_H
+
+#include <memory>
+
+#include <QString>
+#include <QByteArray>
+
+#include <repositorysnapshot.h>
+
+/**
+ * @brief Git状态快照的磁盘持久化
+ *
+ * 每个仓库一个文件，保存在用户缓存目录下，内容为 StatusTable 的平铺布局，
+ * 可直接内存映射加载。快照以 index 校验和与 HEAD oid 作为键，
+ * 键不匹配说明仓库在插件未运行期间发生过变化，快照不再可信。
+ * 快照在进入仓库时按需加载；每次检索后重新写入，文件修改时间即最近使用时间，据此淘汰。
+ */
+class GitSnapshotStore
+{
+public:
+    /**
+     * @brief 计算仓库当前的快照键
+     * @param repositoryPath 仓库路径
+     * @return "<index 校验和>:<HEAD oid>"，不是有效仓库时返回空
+     */
+    static QByteArray repositoryKey(const QString &repositoryPath);
+
+    /**
+     * @brief 保存仓库快照（原子替换旧文件）
+     * @param snapshot 要保存的快照
+     * @return 是否成功
+     */
+    static bool save(const Global::RepositorySnapshot &snapshot);
+
+    /**
+     * @brief 加载仓库快照
+     * @param repositoryPath 仓库路径
+     * @param expectedKey 期望的快照键，为空时不校验
+     * @return 状态表，文件不存在、损坏或键不匹配时返回空
+     */
+    static std::shared_ptr<const Global::StatusTable> load(const QString &repositoryPath,
+                                                           const QByteArray &expectedKey);
+
+    /**
+     * @brief 按最近写入时间淘汰快照：删除超过 maxAgeDays 天未写入的，以及超出 maxCount 的最旧的
+     * @param maxCount 最多保留的快照数
+     * @param maxAgeDays 最长保留天数
+     */
+    static void prune(int maxCount, int maxAgeDays);
+
+private:
+    static QString storeDirectory();
+    static QString snapshotFilePath(const QString &repositoryPath);
+};
+
+#endif   // GITSNAPSHOTSTORE_H
@@ -0,0 +1,162 @@
+#include "gitwatchbudget.h"
+
+#include <QFile>
+#include <QDateTime>
+#include <QDebug>
+
+#include <algorithm>
+#include <limits>
+
+GitWatchBudget::GitWatchBudget(int total)
+{
+    if (total > 0) {
+        m_total = total;
+    } else {
+        const qint64 share { static_cast<qint64>(readKernelLimit()) * KERNEL_SHARE_PERCENT / 100 };
+        m_total = static_cast<int>(qMin<qint64>(share, std::numeric_limits<int>::max()));
+    }
+    qInfo() << "INFO: [GitWatchBudget] Watch budget:" << m_total;
+}
+
+int GitWatchBudget::readKernelLimit()
+{
+    QFile file(QStringLiteral("/proc/sys/fs/inotify/max_user_watches"));
+    if (!file.open(QIODevice::ReadOnly))
+        return DEFAULT_KERNEL_LIMIT;
+
+    bool ok { false };
+    const int limit { file.readAll().trimmed().toInt(&ok) };
+    return ok && limit > 0 ? limit : DEFAULT_KERNEL_LIMIT;
+}
+
+void GitWatchBudget::addRepository(const QString &repositoryPath)
+{
+    if (m_entries.contains(repositoryPath))
+        return;
+
+    Entry entry;
+    entry.allocation.repositoryPath = repositoryPath;
+    entry.allocation.visible = m_visible.contains(repositoryPath);
+    entry.allocation.lastUsed = QDateTime::currentMSecsSinceEpoch();
+    m_entries.insert(repositoryPath, entry);
+}
+
+void GitWatchBudget::removeRepository(const QString &repositoryPath)
+{
+    m_entries.remove(repositoryPath);
+}
+
+void GitWatchBudget::setVisibleRepositories(const QSet<QString> &repositories)
+{
+    const qint64 now { QDateTime::currentMSecsSinceEpoch() };
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        Allocation &allocation { it->allocation };
+        const bool visible { repositories.contains(it.key()) };
+        // 刚离开的仓库也记为最近使用，切换目录后返回时仍排在前面
+        if (visible || allocation.visible)
+            allocation.lastUsed = now;
+        allocation.visible = visible;
+    }
+    m_visible = repositories;
+}
+
+void GitWatchBudget::reportUsage(const QString &repositoryPath, int used, bool complete)
+{
+    auto it = m_entries.find(repositoryPath);
+    if (it == m_entries.end())
+        return;
+
+    it->allocation.used = used;
+    it->allocation.complete = complete;
+    it->demand = complete ? used : -1;
+}
+
+QStringList GitWatchBudget::rebalance()
+{
+    QStringList changed;
+    int available { qMax(0, m_total - static_cast<int>(m_entries.size()) * METADATA_WATCHES) };
+    int full { 0 };
+    int partial { 0 };
+
+    for (const QString &repositoryPath : prioritized()) {
+        Entry *entry { &m_entries[repositoryPath] };
+        Allocation &allocation { entry->allocation };
+        const int cap { qMin(available, MAX_WATCHES_PER_REPO - METADATA_WATCHES) };
+        const int wanted { entry->demand >= 0 ? qMax(0, entry->demand - METADATA_WATCHES) : -1 };
+
+        Level level { Level::MetadataOnly };
+        int extra { 0 };
+        if (wanted >= 0 && wanted <= cap) {
+            // 留出余量给之后新建的目录
+            level = Level::Full;
+            extra = qMin(cap, wanted + wanted / 4);
+        } else if (wanted < 0 && allocation.complete && cap >= MIN_PARTIAL_WATCHES) {
+            // 尚未扫描过，先给出能给的全部，后端报告实际用量后再收回多余部分
+            level = Level::Full;
+            extra = cap;
+        } else if (allocation.visible && cap >= MIN_PARTIAL_WATCHES) {
+            level = Level::Partial;
+            extra = cap;
+        }
+        available -= extra;
+
+        const int granted { METADATA_WATCHES + extra };
+        if (level != allocation.level || granted != allocation.granted)
+            changed.append(allocation.repositoryPath);
+        allocation.level = level;
+        allocation.granted = granted;
+        if (level == Level::Full)
+            ++full;
+        else if (level == Level::Partial)
+            ++partial;
+    }
+
+    if (!changed.isEmpty()) {
+        qInfo() << "INFO: [GitWatchBudget] Rebalanced" << m_entries.size() << "repositories, budget:" << m_total
+                << "full:" << full << "partial:" << partial << "metadata only:" << m_entries.size() - full - partial
+                << "unallocated:" << available;
+    }
+    return changed;
+}
+
+GitWatchBudget::Allocation GitWatchBudget::allocation(const QString &repositoryPath) const
+{
+    auto it = m_entries.constFind(repositoryPath);
+    if (it != m_entries.constEnd())
+        return it->allocation;
+
+    Allocation allocation;
+    allocation.repositoryPath = repositoryPath;
+    return allocation;
+}
+
+QList<GitWatchBudget::Allocation> GitWatchBudget::allocations() const
+{
+    QList<Allocation> result;
+    for (const QString &repositoryPath : prioritized())
+        result.append(m_entries.value(repositoryPath).allocation);
+    return result;
+}
+
+QStringList GitWatchBudget::prioritized() const
+{
+    QList<const Entry *> entries;
+    entries.reserve(m_entries.size());
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it)
+        entries.append(&it.value());
+
+    // 可见的仓库优先，其次按最近使用时间
+    std::sort(entries.begin(), entries.end(), [](const Entry *lhs, const Entry *rhs) {
+        if (lhs->allocation.visible != rhs->allocation.visible)
+            return lhs->allocation.visible;
+        if (lhs->allocation.lastUsed != rhs->allocation.lastUsed)
+            return lhs->allocation.lastUsed > rhs->allocation.lastUsed;
+        return lhs->allocation.repositoryPath < rhs->allocation.repositoryPath;
+    });
+
+    QStringList result;
+    result.reserve(entries.size());
+    for (const Entry *entry : std::as_const(entries))
+        result.append(entry->allocation.repositoryPath);
+    return result;
+}
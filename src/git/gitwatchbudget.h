@@ -0,0 +1,112 @@
+#ifndef GITWATCHBUDGET_H
+#define GITWATCHBUDGET_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QList>
+
+/**
+ * @brief 跨仓库的 inotify 监控配额
+ *
+ * inotify 监控数受 fs.inotify.max_user_watches 限制，且由同一用户的所有进程共享。
+ * 配额按内核上限的 KERNEL_SHARE_PERCENT 计算，每个仓库先预留元数据（index、HEAD、refs）的监控，
+ * 其余按优先级分给工作区：窗口中可见的仓库优先，其次按最近使用时间。
+ *
+ * 分配结果分三级：
+ * - Full：完整监控工作区；
+ * - Partial：可见但配额不足以完整监控，监控到上限为止，其余依靠定时检索；
+ * - MetadataOnly：只监控元数据，工作区依靠定时检索，重新可见时再升级。
+ *
+ * 不是线程安全的，只在 GitFileSystemWatcher 所在的界面线程使用。
+ */
+class GitWatchBudget
+{
+public:
+    enum class Level {
+        Full,
+        Partial,
+        MetadataOnly
+    };
+
+    /**
+     * @brief 一个仓库的分配结果，用于诊断
+     */
+    struct Allocation
+    {
+        QString repositoryPath;
+        Level level { Level::MetadataOnly };
+        int granted { 0 };   ///< 允许使用的监控数（含元数据）
+        int used { 0 };   ///< 后端报告的实际监控数
+        bool complete { true };   ///< 配额内是否容纳了整个工作区
+        bool visible { false };
+        qint64 lastUsed { 0 };   ///< 最近一次可见的时间（毫秒）
+    };
+
+    /**
+     * @param total 可用的监控总数，<= 0 时按内核上限计算
+     */
+    explicit GitWatchBudget(int total = 0);
+
+    /**
+     * @brief 读取 /proc/sys/fs/inotify/max_user_watches，读取失败返回 DEFAULT_KERNEL_LIMIT
+     */
+    static int readKernelLimit();
+
+    int total() const { return m_total; }
+
+    void addRepository(const QString &repositoryPath);
+    void removeRepository(const QString &repositoryPath);
+
+    /**
+     * @brief 更新窗口中可见的仓库，进入或离开可见集合的仓库刷新最近使用时间
+     * @param repositories 可见的仓库根目录
+     */
+    void setVisibleRepositories(const QSet<QString> &repositories);
+
+    /**
+     * @brief 监控后端报告仓库的实际用量
+     * @param repositoryPath 仓库路径
+     * @param used 实际监控数
+     * @param complete 配额内是否容纳了整个工作区
+     */
+    void reportUsage(const QString &repositoryPath, int used, bool complete);
+
+    /**
+     * @brief 重新分配配额
+     * @return 级别或配额发生变化的仓库
+     */
+    QStringList rebalance();
+
+    /**
+     * @brief 仓库当前的分配，未加入的仓库返回 MetadataOnly
+     */
+    Allocation allocation(const QString &repositoryPath) const;
+
+    /**
+     * @brief 所有仓库的分配，按优先级排序
+     */
+    QList<Allocation> allocations() const;
+
+private:
+    struct Entry
+    {
+        Allocation allocation;
+        int demand { -1 };   ///< 完整监控需要的数量，-1 表示未知（尚未扫描或超出过配额）
+    };
+
+    QStringList prioritized() const;
+
+    int m_total { 0 };
+    QHash<QString, Entry> m_entries;   ///< 仓库 -> 分配
+    QSet<QString> m_visible;   ///< 可见的仓库，可能包含尚未加入的仓库
+
+    static constexpr int DEFAULT_KERNEL_LIMIT = 8192;   ///< 内核的默认上限
+    static constexpr int KERNEL_SHARE_PERCENT = 25;   ///< 占用内核上限的比例，其余留给其他程序
+    static constexpr int METADATA_WATCHES = 32;   ///< 每个仓库为元数据预留的监控数
+    static constexpr int MAX_WATCHES_PER_REPO = 10000;   ///< 单个仓库的配额上限
+    static constexpr int MIN_PARTIAL_WATCHES = 64;   ///< 少于该数量时部分监控意义不大，只监控元数据
+};
+
+#endif   // GITWATCHBUDGET_H
@@ -1,164 +1,735 @@
 #include "gitwindowplugin.h"
 #include "gitfilesystemwatcher.h"
+#include "gitrepositoryinfo.h"
+#include "gitrepositoryresolver.h"
 
 #include <QUrl>
 #include <QProcess>
-#include <QTextCodec>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QMutexLocker>
 #include <QCoreApplication>
 #include <QDebug>
 
+#include <atomic>
+
 #include <cache.h>
 
 #include "utils.h"
+#include "gitsnapshotstore.h"
+#include "gitdirectorystatetree.h"
+#include "gitporcelainparser.h"
 #include "common/gitrepositoryservice.h"
 
 using Global::ItemVersion;
 
-// 计算仓库根目录状态的辅助函数
-static ItemVersion calculateRepositoryRootStatus(const QHash<QString, ItemVersion> &versionInfoHash)
+static constexpr int CANCEL_POLL_INTERVAL_MS = 100;   // 检索过程中检查取消请求的间隔
+
+// 一次检索的控制块，由调度线程与线程池中的检索任务共享
+struct RetrievalControl
 {
-    if (versionInfoHash.isEmpty()) {
-        return ItemVersion::NormalVersion;
+    std::atomic_bool started { false };   ///< 任务已开始执行 git status
+    std::atomic_bool cancelled { false };   ///< 调度线程要求放弃本次检索
+    std::atomic<qint64> startedAt { 0 };   ///< 开始时间（毫秒）
+};
+
+// 检索仓库的文件状态，得到相对仓库根目录的路径 -> 状态（只含非 NormalVersion 的文件）
+// pathspec 为空时覆盖整个仓库，在同一仓库的不同子目录间浏览时结果可以直接复用；
+// 否则只检索这些相对路径，由调用方替换范围内的旧状态
+// 被取消或 git 执行失败时返回 false
+static bool retrieval(const QString &repositoryPath, const QStringList &pathspec, const RetrievalControl &control,
+                      QHash<QString, Global::ItemVersion> *fileStates)
+{
+    // 路径按字面匹配，文件名中的 *、? 等不当作通配符
+    QStringList arguments { "--no-optional-locks", "--literal-pathspecs", "status", "--porcelain", "-z", "-u", "--ignored" };
+    if (!pathspec.isEmpty())
+        arguments << "--" << pathspec;
+
+    QProcess process;
+    process.setWorkingDirectory(repositoryPath);
+    process.start("git", arguments);
+    GitPorcelainParser parser;
+
+    qDebug() << "[GitVersionWorker] Retrieving status for repository:" << repositoryPath
+             << "paths:" << (pathspec.isEmpty() ? QStringLiteral("all") : QString::number(pathspec.size()));
+    // 按块读取并解析，路径只在写入结果时解码一次
+    auto handler = [fileStates](char X, char Y, std::string_view fileName) {
+        // X and Y from the table in `man git-status`
+        ItemVersion state { ItemVersion::NormalVersion };
+        if (X == 'R')
+            state = ItemVersion::LocallyModifiedVersion;
+        state = Utils::parseXYState(state, X, Y);
+
+        // decide what to record about that file
+        if (state == ItemVersion::NormalVersion)
+            return;
+
+        // porcelain 输出的路径总是相对于仓库根目录，目录状态由 GitDirectoryStateTree 聚合
+        fileStates->insert(QString::fromUtf8(fileName.data(), static_cast<int>(fileName.size())), state);
+    };
+
+    while (process.state() != QProcess::NotRunning) {
+        if (control.cancelled.load()) {
+            process.kill();
+            process.waitForFinished();
+            qDebug() << "[GitVersionWorker] Cancelled status for repository:" << repositoryPath;
+            return false;
+        }
+        if (process.waitForReadyRead(CANCEL_POLL_INTERVAL_MS)) {
+            const QByteArray &chunk { process.readAllStandardOutput() };
+            parser.feed(chunk.constData(), static_cast<std::size_t>(chunk.size()), handler);
+        }
+    }
+    const QByteArray &rest { process.readAllStandardOutput() };
+    parser.feed(rest.constData(), static_cast<std::size_t>(rest.size()), handler);
+    parser.finish(handler);
+
+    if (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+        qWarning() << "WARNING: [GitVersionWorker] git status failed for repository:" << repositoryPath
+                   << "exit code:" << process.exitCode();
+        return false;
     }
 
-    ItemVersion rootState = ItemVersion::NormalVersion;
+    qDebug() << "[GitVersionWorker] Parsed" << parser.recordCount() << "records," << fileStates->size() << "file states";
 
-    // 遍历所有状态，找出最高优先级的状态
-    for (auto it = versionInfoHash.begin(); it != versionInfoHash.end(); ++it) {
-        ItemVersion currentState = it.value();
+    return true;
+}
 
-        // 忽略IgnoredVersion，它不应该影响根目录状态
-        if (currentState == ItemVersion::IgnoredVersion) {
-            continue;
+// 在线程池中执行一次 git status，结果投递回调度线程
+class GitStatusJob : public QRunnable
+{
+public:
+    GitStatusJob(GitVersionWorker *worker, const QString &repositoryPath, const QStringList &pathspec,
+                 quint64 generation, std::shared_ptr<RetrievalControl> control)
+        : m_worker(worker), m_repositoryPath(repositoryPath), m_pathspec(pathspec), m_generation(generation),
+          m_control(std::move(control))
+    {
+    }
+
+    void run() override
+    {
+        QHash<QString, ItemVersion> fileStates;
+        bool completed { false };
+        QElapsedTimer timer;
+        timer.start();
+
+        // 排队期间已被取消的任务不再启动 git
+        if (!m_control->cancelled.load()) {
+            m_control->startedAt.store(QDateTime::currentMSecsSinceEpoch());
+            m_control->started.store(true);
+            completed = ::retrieval(m_repositoryPath, m_pathspec, *m_control, &fileStates);
+        }
+
+        const qint64 cost { timer.elapsed() };
+        QMetaObject::invokeMethod(m_worker, [worker = m_worker, repositoryPath = m_repositoryPath,
+                                             generation = m_generation, completed, cost, fileStates]() {
+            worker->onRetrievalFinished(repositoryPath, generation, completed, cost, fileStates);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    GitVersionWorker *m_worker { nullptr };
+    QString m_repositoryPath;
+    QStringList m_pathspec;   ///< 为空表示整个仓库
+    quint64 m_generation { 0 };
+    std::shared_ptr<RetrievalControl> m_control;
+};
+
+// 在线程池中刷新分支信息，完成后通知调度线程
+class GitInfoJob : public QRunnable
+{
+public:
+    GitInfoJob(GitVersionWorker *worker, const QString &repositoryPath, bool branch)
+        : m_worker(worker), m_repositoryPath(repositoryPath), m_branch(branch)
+    {
+    }
+
+    void run() override
+    {
+        if (m_branch)
+            GitRepositoryInfoStore::instance().refreshBranch(m_repositoryPath);
+        else
+            GitRepositoryInfoStore::instance().refreshTracking(m_repositoryPath);
+
+        QMetaObject::invokeMethod(m_worker, [worker = m_worker, repositoryPath = m_repositoryPath]() {
+            worker->onInfoRefreshed(repositoryPath);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    GitVersionWorker *m_worker { nullptr };
+    QString m_repositoryPath;
+    bool m_branch { false };
+};
+
+bool GitVersionWorker::Scope::covers(const Scope &other) const
+{
+    if (full)
+        return true;
+    if (other.full)
+        return false;
+    for (const QString &path : other.paths) {
+        if (!paths.contains(path))
+            return false;
+    }
+    return true;
+}
+
+void GitVersionWorker::Scope::merge(const Scope &other)
+{
+    if (!full && !other.full) {
+        paths.unite(other.paths);
+        if (paths.size() <= MAX_PATHSPEC_SIZE)
+            return;
+    }
+    full = true;
+    paths.clear();
+}
+
+GitVersionWorker::GitVersionWorker()
+    : m_pool(new QThreadPool(this))
+{
+    m_pool->setMaxThreadCount(workerCount());
+    qInfo() << "INFO: [GitVersionWorker] Status worker pool size:" << m_pool->maxThreadCount();
+}
+
+GitVersionWorker::~GitVersionWorker()
+{
+    qInfo() << "INFO: [GitVersionWorker] Requests:" << m_statistics.requests
+            << "retrievals:" << m_statistics.retrievals << "coalesced:" << m_statistics.coalesced
+            << "cancelled:" << m_statistics.cancelled << "dropped navigations:" << m_statistics.droppedNavigations
+            << "promoted:" << m_statistics.promoted << "deferred:" << m_statistics.deferred
+            << "path limited:" << m_statistics.pathLimited << "metadata only:" << m_statistics.metadataOnly
+            << "moved paths:" << m_statistics.movedPaths;
+
+    // 丢弃尚未开始的检索，结束正在运行的 git status
+    m_pool->clear();
+    for (const Retrieval &entry : std::as_const(m_retrievals))
+        entry.control->cancelled.store(true);
+    m_pool->waitForDone();
+}
+
+int GitVersionWorker::workerCount()
+{
+    bool ok { false };
+    const int configured { qEnvironmentVariableIntValue("DFM_GIT_STATUS_WORKERS", &ok) };
+    if (ok && configured > 0)
+        return qMin(configured, MAX_CONFIGURED_WORKERS);
+
+    return qBound(1, QThread::idealThreadCount(), MAX_STATUS_WORKERS);
+}
+
+quint64 GitVersionWorker::beginNavigation(quint64 winId)
+{
+    QMutexLocker locker(&m_navigationMutex);
+    // 序号全局递增，窗口离开后再回来也不会与旧请求的序号重复
+    const quint64 serial { ++m_lastNavigationSerial };
+    m_navigationSerials.insert(winId, serial);
+    return serial;
+}
+
+void GitVersionWorker::endNavigation(quint64 winId)
+{
+    QMutexLocker locker(&m_navigationMutex);
+    m_navigationSerials.remove(winId);
+}
+
+bool GitVersionWorker::isCurrentNavigation(quint64 winId, quint64 serial) const
+{
+    QMutexLocker locker(&m_navigationMutex);
+    return m_navigationSerials.value(winId) == serial;
+}
+
+void GitVersionWorker::onRetrieval(const QUrl &url)
+{
+    const QString &repositoryPath { Utils::repositoryBaseDir(url.toLocalFile()) };
+    if (repositoryPath.isEmpty())
+        return;
+
+    request(repositoryPath, RequestKind::Background);
+}
+
+void GitVersionWorker::onImmediateRetrieval(const QUrl &url)
+{
+    const QString &repositoryPath { Utils::repositoryBaseDir(url.toLocalFile()) };
+    if (repositoryPath.isEmpty())
+        return;
+
+    request(repositoryPath, RequestKind::Immediate);
+}
+
+void GitVersionWorker::onRepositoryChanged(const QString &repositoryPath, int changes, const QStringList &paths)
+{
+    if (repositoryPath.isEmpty())
+        return;
+
+    // 分支与上游信息：引用、配置变化重新读取分支，fetch 只影响领先/落后计数
+    if (changes & (GitFileSystemWatcher::RefChange | GitFileSystemWatcher::ConfigChange))
+        refreshInfo(repositoryPath, InfoRefresh::Branch);
+    else if (changes & GitFileSystemWatcher::FetchChange)
+        refreshInfo(repositoryPath, InfoRefresh::Tracking);
+
+    // 上次完整检索以来 index、HEAD 没有变化时，工作区以外的文件状态不会变
+    auto fingerprint = m_fullFingerprints.constFind(repositoryPath);
+    const bool metadataUnchanged { fingerprint != m_fullFingerprints.constEnd()
+                                   && fingerprint.value() == Utils::readRepositoryFingerprint(repositoryPath) };
+
+    // index、配置变化，或引用变化移动了 HEAD（提交、切换分支、reset）：完整检索
+    if ((changes & (GitFileSystemWatcher::IndexChange | GitFileSystemWatcher::ConfigChange))
+        || ((changes & GitFileSystemWatcher::RefChange) && !metadataUnchanged)) {
+        request(repositoryPath, RequestKind::Background);
+        return;
+    }
+
+    if (!(changes & GitFileSystemWatcher::WorkTreeChange)) {
+        ++m_statistics.metadataOnly;
+        qDebug() << "[GitVersionWorker] Metadata-only change, skipping status:" << repositoryPath;
+        return;
+    }
+
+    // 仓库尚未发布过完整结果，或 index、HEAD 在监控之外发生了变化（如监控退化时）：
+    // 范围外的文件状态同样可能过期，只能完整检索
+    Scope scope;
+    if (!paths.isEmpty() && m_trees.contains(repositoryPath) && metadataUnchanged) {
+        scope.full = false;
+        const QString &prefix { repositoryPath + '/' };
+        for (const QString &path : paths) {
+            if (!path.startsWith(prefix)) {
+                scope.full = true;
+                break;
+            }
+            scope.paths.insert(path.mid(prefix.size()));
         }
+        if (scope.full || scope.paths.size() > MAX_PATHSPEC_SIZE)
+            scope = Scope();
+    }
+
+    request(repositoryPath, RequestKind::Background, scope);
+}
+
+void GitVersionWorker::onPathsMoved(const QString &repositoryPath, const QStringList &sources, const QStringList &targets)
+{
+    // 尚未发布过结果的仓库没有可迁移的记录
+    const auto tree { m_trees.value(repositoryPath) };
+    if (!tree || sources.size() != targets.size())
+        return;
 
-        // 状态优先级：ConflictingVersion > LocallyModifiedUnstagedVersion > LocallyModifiedVersion > 其他状态
-        if (currentState == ItemVersion::ConflictingVersion) {
-            return ItemVersion::ConflictingVersion;   // 最高优先级，直接返回
-        } else if (currentState == ItemVersion::LocallyModifiedUnstagedVersion && rootState != ItemVersion::ConflictingVersion) {
-            rootState = ItemVersion::LocallyModifiedUnstagedVersion;
-        } else if (currentState == ItemVersion::LocallyModifiedVersion && rootState != ItemVersion::ConflictingVersion && rootState != ItemVersion::LocallyModifiedUnstagedVersion) {
-            rootState = ItemVersion::LocallyModifiedVersion;
-        } else if (rootState == ItemVersion::NormalVersion) {
-            // 如果根目录状态还是Normal，则使用当前状态
-            rootState = currentState;
+    Global::VersionDelta delta;
+    delta.repositoryPath = repositoryPath;
+    const QString &prefix { repositoryPath + '/' };
+    for (int i = 0; i < sources.size(); ++i) {
+        if (!sources.at(i).startsWith(prefix) || !targets.at(i).startsWith(prefix))
+            continue;
+        const QString &target { targets.at(i).mid(prefix.size()) };
+        if (tree->movePath(sources.at(i).mid(prefix.size()), target, &delta) > 0) {
+            m_provisionalMoves[repositoryPath].insert(target);
+            ++m_statistics.movedPaths;
         }
     }
 
-    return rootState;
+    // 新位置立即显示原来的状态，随后两端路径的检索结果会替换它
+    if (!delta.isEmpty()) {
+        qDebug() << "[GitVersionWorker] Moved cached states provisionally:" << repositoryPath
+                 << "changed:" << delta.changed.size() << "removed:" << delta.removed.size();
+        publish(*tree, delta);
+    }
 }
 
-static QHash<QString, Global::ItemVersion> retrieval(const QString &directory)
+void GitVersionWorker::confirmMoves(const QString &repositoryPath, const Scope &scope)
 {
-    // cache git status for current path
-    QProcess process;
-    process.setWorkingDirectory(directory);
-    process.start("git", { "--no-optional-locks", "status", "--porcelain", "-z", "-u", "--ignored" });
-    const QString &dirBelowBaseDir { Utils::findPathBelowGitBaseDir(directory) };
-    QHash<QString, ItemVersion> versionInfoHash;
-
-    qDebug() << "[GitVersionWorker] Retrieving status for directory:" << directory
-             << "dirBelowBaseDir:" << dirBelowBaseDir;
-    while (process.waitForReadyRead()) {
-        char buffer[1024];
-        while (Utils::readUntilZeroChar(&process, buffer, sizeof(buffer)) > 0) {
-            const QString &line { QTextCodec::codecForLocale()->toUnicode(buffer) };
-            // X and Y from the table in `man git-status`
-            const auto [X, Y, fileName] { Utils::parseLineGitStatus(line) };
-            ItemVersion state { ItemVersion::NormalVersion };
-            // Renames list the old file name directly afterwards, separated by \0.
-            if (X == 'R') {
-                state = ItemVersion::LocallyModifiedVersion;
-                Utils::readUntilZeroChar(&process, nullptr, 0);   // discard old file name
+    auto it = m_provisionalMoves.find(repositoryPath);
+    if (it == m_provisionalMoves.end())
+        return;
+
+    if (scope.full) {
+        m_provisionalMoves.erase(it);
+        return;
+    }
+    for (auto target = it->begin(); target != it->end();) {
+        bool covered { false };
+        for (const QString &path : scope.paths) {
+            if (*target == path || target->startsWith(path + '/')) {
+                covered = true;
+                break;
             }
-            state = Utils::parseXYState(state, X, Y);
-
-            // decide what to record about that file
-            if (state == ItemVersion::NormalVersion || !fileName.startsWith(dirBelowBaseDir))
-                continue;
-
-            // File name relative to the current working directory.
-            const QString &relativeFileName { fileName.mid(dirBelowBaseDir.length()) };
-            const QString &absoluteFileName { directory + "/" + relativeFileName };
-            Q_ASSERT(QUrl::fromLocalFile(absoluteFileName).isValid());
-            // normal file, no directory
-            versionInfoHash.insert(absoluteFileName, state);
-
-            // if file is part of a sub-directory, record the directory
-            if (relativeFileName.contains('/')) {
-                ItemVersion dirState = state;
-
-                // 对于被忽略的文件，其父目录应该显示为忽略状态
-                // 但优先级较低，可以被其他状态覆盖
-                if (state == ItemVersion::IgnoredVersion) {
-                    dirState = ItemVersion::IgnoredVersion;
-                } else {
-                    // 对于其他状态，保持原有逻辑
-                    if (state == ItemVersion::AddedVersion || state == ItemVersion::RemovedVersion)
-                        dirState = ItemVersion::LocallyModifiedVersion;
-                }
-
-                const QStringList &absoluteDirNames { Utils::makeDirGroup(directory, relativeFileName) };
-                for (const auto &absoluteDirName : absoluteDirNames) {
-                    Q_ASSERT(QUrl::fromLocalFile(absoluteDirName).isValid());
-                    if (versionInfoHash.contains(absoluteDirName)) {
-                        ItemVersion oldState = versionInfoHash.value(absoluteDirName);
-
-                        // 目录状态优先级（从高到低）：
-                        // ConflictingVersion > LocallyModifiedUnstagedVersion > LocallyModifiedVersion > 其他状态 > IgnoredVersion
-                        if (oldState == ItemVersion::ConflictingVersion)
-                            continue;
-                        if (oldState == ItemVersion::LocallyModifiedUnstagedVersion && dirState != ItemVersion::ConflictingVersion)
-                            continue;
-                        if (oldState == ItemVersion::LocallyModifiedVersion
-                            && dirState != ItemVersion::LocallyModifiedUnstagedVersion && dirState != ItemVersion::ConflictingVersion)
-                            continue;
-
-                        // 如果旧状态不是IgnoredVersion，但新状态是IgnoredVersion，不覆盖
-                        if (oldState != ItemVersion::IgnoredVersion && dirState == ItemVersion::IgnoredVersion)
-                            continue;
-
-                        versionInfoHash.insert(absoluteDirName, dirState);
-                    } else {
-                        versionInfoHash.insert(absoluteDirName, dirState);
-                    }
-                }
+        }
+        if (covered)
+            target = it->erase(target);
+        else
+            ++target;
+    }
+    if (it->isEmpty())
+        m_provisionalMoves.erase(it);
+}
+
+void GitVersionWorker::refreshInfo(const QString &repositoryPath, InfoRefresh refresh)
+{
+    // 同一仓库同一时间只有一个刷新在运行，期间的请求合并为结束后的一次
+    auto it = m_infoRefreshes.find(repositoryPath);
+    if (it != m_infoRefreshes.end()) {
+        it.value() = qMax(it.value(), refresh);
+        return;
+    }
+
+    m_infoRefreshes.insert(repositoryPath, InfoRefresh::None);
+    m_pool->start(new GitInfoJob(this, repositoryPath, refresh == InfoRefresh::Branch), URGENT_PRIORITY);
+}
+
+void GitVersionWorker::onInfoRefreshed(const QString &repositoryPath)
+{
+    const InfoRefresh pending { m_infoRefreshes.take(repositoryPath) };
+    if (pending != InfoRefresh::None)
+        refreshInfo(repositoryPath, pending);
+}
+
+void GitVersionWorker::onNavigation(quint64 winId, quint64 serial, const QUrl &url, bool retrieve)
+{
+    // 窗口已经离开了这个目录（或已关闭），请求不再有意义
+    if (!isCurrentNavigation(winId, serial)) {
+        ++m_statistics.droppedNavigations;
+        qDebug() << "[GitVersionWorker] Dropped stale navigation request:" << url;
+        return;
+    }
+
+    const QString &repositoryPath { Utils::repositoryBaseDir(url.toLocalFile()) };
+    const QString &previous { m_windowRepositories.value(winId) };
+    if (repositoryPath.isEmpty())
+        m_windowRepositories.remove(winId);
+    else
+        m_windowRepositories.insert(winId, repositoryPath);
+
+    if (previous != repositoryPath)
+        dropNavigationRetrieval(previous);
+
+    if (retrieve && !repositoryPath.isEmpty()) {
+        restoreSnapshot(repositoryPath);
+        request(repositoryPath, RequestKind::Navigation);
+    }
+}
+
+void GitVersionWorker::onWindowLeft(quint64 winId)
+{
+    dropNavigationRetrieval(m_windowRepositories.take(winId));
+}
+
+void GitVersionWorker::request(const QString &repositoryPath, RequestKind kind, const Scope &scope)
+{
+    ++m_statistics.requests;
+
+    const bool urgent { kind != RequestKind::Background || isVisible(repositoryPath) };
+
+    // 同一仓库的检索不并发执行；检索期间到达的请求合并为结束后的一次重新检索
+    auto it = m_retrievals.find(repositoryPath);
+    if (it == m_retrievals.end()) {
+        // 不可见仓库的后台刷新按检索耗时限速，推迟到允许的时间再执行
+        if (!urgent) {
+            const qint64 delay { backgroundDelay(repositoryPath) };
+            if (delay > 0) {
+                deferRetrieval(repositoryPath, delay, scope);
+                return;
             }
         }
+        // 推迟中的后台刷新并入这次检索
+        Scope merged { scope };
+        auto deferred = m_deferred.find(repositoryPath);
+        if (deferred != m_deferred.end()) {
+            merged.merge(deferred.value());
+            m_deferred.erase(deferred);
+        }
+        startRetrieval(repositoryPath, kind == RequestKind::Navigation, urgent, 0, merged);
+        return;
     }
 
-    // 计算并设置仓库根目录状态
-    ItemVersion rootStatus = calculateRepositoryRootStatus(versionInfoHash);
-    versionInfoHash.insert(directory, rootStatus);
-    qDebug() << "[GitVersionWorker] Repository root status set to:" << static_cast<int>(rootStatus) << "for:" << directory;
+    // 低优先级的检索还在队列中，而仓库现在需要尽快展示：以高优先级重新排队
+    if (urgent && !it->urgent && !it->control->started.load()) {
+        it->control->cancelled.store(true);
+        ++m_statistics.promoted;
+        qDebug() << "[GitVersionWorker] Promoting queued retrieval:" << repositoryPath;
+        Scope merged { it->scope };
+        merged.merge(scope);
+        startRetrieval(repositoryPath, it->navigationOnly && kind == RequestKind::Navigation, true, 0, merged);
+        return;
+    }
+
+    if (kind != RequestKind::Navigation)
+        it->navigationOnly = false;
+
+    // 尚未启动的检索会看到这次请求之前的所有变化，范围不够时扩大范围重新排队
+    if (!it->control->started.load()) {
+        ++m_statistics.coalesced;
+        if (!it->scope.covers(scope)) {
+            it->control->cancelled.store(true);
+            Scope merged { it->scope };
+            merged.merge(scope);
+            startRetrieval(repositoryPath, it->navigationOnly, it->urgent, 0, merged);
+        }
+        qDebug() << "[GitVersionWorker] Coalesced retrieval request:" << repositoryPath
+                 << "total:" << m_statistics.coalesced;
+        return;
+    }
 
-    qDebug() << "[GitVersionWorker] Final versionInfoHash contains" << versionInfoHash.size() << "entries";
+    // 已标记 Dirty 的只需再检索一次，范围取所有请求的并集
+    if (it->dirty) {
+        ++m_statistics.coalesced;
+        it->pending.merge(scope);
+        qDebug() << "[GitVersionWorker] Coalesced retrieval request:" << repositoryPath
+                 << "total:" << m_statistics.coalesced;
+        return;
+    }
+    it->dirty = true;
+    it->pending = scope;
+
+    // 正在运行的结果必然过期：刚开始不久的直接结束，尽快以新的一代重新检索；
+    // 快要完成的让它发布，避免持续变化的仓库永远得不到结果
+    const qint64 elapsed { QDateTime::currentMSecsSinceEpoch() - it->control->startedAt.load() };
+    const qint64 expected { m_statusCosts.value(repositoryPath, -1) };
+    if (it->cancellations < MAX_CONSECUTIVE_CANCELLATIONS && (expected < 0 || elapsed * 2 < expected)) {
+        it->control->cancelled.store(true);
+        ++it->cancellations;
+        ++m_statistics.cancelled;
+        qDebug() << "[GitVersionWorker] Cancelling outdated retrieval:" << repositoryPath
+                 << "generation:" << it->generation;
+        return;
+    }
 
-    return versionInfoHash;
+    qDebug() << "[GitVersionWorker] Retrieval in progress, marked dirty:" << repositoryPath;
 }
 
-void GitVersionWorker::onRetrieval(const QUrl &url)
+void GitVersionWorker::dropNavigationRetrieval(const QString &repositoryPath)
 {
-    if (!Utils::isInsideRepositoryDir(url.toLocalFile()))
+    if (repositoryPath.isEmpty())
         return;
 
-    const QString &directory { url.toLocalFile() };
-    const QString &repositoryPath { Utils::repositoryBaseDir(directory) };
-    if (Q_UNLIKELY(repositoryPath.isEmpty()))
+    // 还有窗口停留在该仓库中
+    for (auto it = m_windowRepositories.cbegin(); it != m_windowRepositories.cend(); ++it) {
+        if (it.value() == repositoryPath)
+            return;
+    }
+
+    // 只取消仍在队列中、且仅由导航触发的检索，已经启动的让它完成
+    auto it = m_retrievals.find(repositoryPath);
+    if (it == m_retrievals.end() || !it->navigationOnly || it->control->started.load())
+        return;
+
+    it->control->cancelled.store(true);
+    it->dirty = false;
+    ++m_statistics.droppedNavigations;
+    qDebug() << "[GitVersionWorker] Dropped queued navigation retrieval:" << repositoryPath;
+}
+
+bool GitVersionWorker::isVisible(const QString &repositoryPath) const
+{
+    for (auto it = m_windowRepositories.cbegin(); it != m_windowRepositories.cend(); ++it) {
+        if (it.value() == repositoryPath)
+            return true;
+    }
+    return false;
+}
+
+qint64 GitVersionWorker::backgroundDelay(const QString &repositoryPath) const
+{
+    auto finished = m_lastFinished.constFind(repositoryPath);
+    if (finished == m_lastFinished.constEnd())
+        return 0;
+
+    // git status 越慢，后台刷新的间隔越长，使后台检索占用的时间不超过 1/BACKGROUND_COST_FACTOR
+    const qint64 cost { m_statusCosts.value(repositoryPath) };
+    const qint64 interval { qBound(MIN_BACKGROUND_INTERVAL_MS, cost * BACKGROUND_COST_FACTOR, MAX_BACKGROUND_INTERVAL_MS) };
+    return finished.value() + interval - QDateTime::currentMSecsSinceEpoch();
+}
+
+void GitVersionWorker::deferRetrieval(const QString &repositoryPath, qint64 delay, const Scope &scope)
+{
+    ++m_statistics.deferred;
+    auto it = m_deferred.find(repositoryPath);
+    if (it != m_deferred.end()) {
+        it->merge(scope);
         return;
+    }
+
+    qDebug() << "[GitVersionWorker] Deferring background retrieval:" << repositoryPath << "by" << delay << "ms";
+    m_deferred.insert(repositoryPath, scope);
+    QTimer::singleShot(static_cast<int>(delay), this, [this, repositoryPath]() {
+        // 期间已经以更高优先级检索过
+        auto it = m_deferred.find(repositoryPath);
+        if (it == m_deferred.end())
+            return;
+        const Scope scope { it.value() };
+        m_deferred.erase(it);
+        request(repositoryPath, RequestKind::Background, scope);
+    });
+}
+
+void GitVersionWorker::startRetrieval(const QString &repositoryPath, bool navigation, bool urgent, int cancellations,
+                                      Scope scope)
+{
+    // 聚合树不存在时没有可供增量替换的旧状态
+    if (!scope.full && !m_trees.contains(repositoryPath))
+        scope = Scope();
+
+    Retrieval entry;
+    entry.control = std::make_shared<RetrievalControl>();
+    entry.generation = ++m_nextGeneration;
+    entry.cancellations = cancellations;
+    entry.navigationOnly = navigation;
+    entry.urgent = urgent;
+    entry.scope = scope;
+    m_retrievals.insert(repositoryPath, entry);
+    ++m_statistics.retrievals;
+
+    QStringList pathspec;
+    if (scope.full) {
+        // 之后的按路径检索以此判断 index、HEAD 是否在监控之外发生过变化
+        m_fullFingerprints.insert(repositoryPath, Utils::readRepositoryFingerprint(repositoryPath));
+    } else {
+        pathspec = scope.paths.values();
+        ++m_statistics.pathLimited;
+    }
+
+    // 窗口中可见的仓库优先于后台刷新
+    m_pool->start(new GitStatusJob(this, repositoryPath, pathspec, entry.generation, entry.control),
+                  urgent ? URGENT_PRIORITY : BACKGROUND_PRIORITY);
+}
+
+void GitVersionWorker::onRetrievalFinished(const QString &repositoryPath, quint64 generation, bool completed,
+                                           qint64 cost, const QHash<QString, ItemVersion> &fileStates)
+{
+    // 只接受当前这一代的结果
+    auto it = m_retrievals.find(repositoryPath);
+    if (it == m_retrievals.end() || it->generation != generation)
+        return;
+    const Retrieval entry { it.value() };
+    m_retrievals.erase(it);
+
+    if (completed) {
+        // 按路径检索的耗时不代表完整检索，不参与限速与中止的估算
+        if (entry.scope.full) {
+            m_statusCosts.insert(repositoryPath, cost);
+            emit statusCostMeasured(repositoryPath, cost);
+        }
+        m_lastFinished.insert(repositoryPath, QDateTime::currentMSecsSinceEpoch());
+
+        auto &tree { m_trees[repositoryPath] };
+        if (!tree)
+            tree = std::make_shared<GitDirectoryStateTree>(repositoryPath);
+
+        // 目录及根目录状态由聚合树按变化的文件增量推导
+        Global::VersionDelta delta;
+        delta.repositoryPath = repositoryPath;
+        if (entry.scope.full)
+            tree->replaceAll(fileStates, &delta);
+        else
+            tree->replaceWithin(entry.scope.paths.values(), fileStates, &delta);
+        confirmMoves(repositoryPath, entry.scope);
+        publish(*tree, delta);
+
+        // 首次检索到的仓库还没有分支信息，之后由引用与 fetch 变化保持更新
+        GitRepositoryInfo info;
+        if (!GitRepositoryInfoStore::instance().info(repositoryPath, &info))
+            refreshInfo(repositoryPath, InfoRefresh::Branch);
+    } else if (!entry.control->cancelled.load() && !entry.scope.full) {
+        // 按路径检索失败（路径进入了子模块等），改为完整检索
+        requeueRetrieval(repositoryPath, entry, 0);
+        return;
+    }
+
+    // 检索期间仓库又有变化（或被新请求取消），再检索一次；被取消的范围并入下一次
+    if (entry.dirty) {
+        Scope next { entry.pending };
+        if (!completed)
+            next.merge(entry.scope);
+        requeueRetrieval(repositoryPath, entry, completed ? 0 : entry.cancellations, next);
+    }
 
-    // retrival
-    auto versionInfoHash { ::retrieval(directory) };
-    // 关键修复：不要在versionInfoHash为空时插入NormalVersion
-    // 空的versionInfoHash意味着没有任何文件状态变化，这是正常的
-    // 让Global::Cache来处理缺失的条目，它会正确返回NormalVersion
+    // 失败（仓库被删除等）或被取消且没有后续检索时，暂定的改名不会再被确认，不能让它一直阻止快照保存
+    if (!completed && !m_retrievals.contains(repositoryPath) && !m_deferred.contains(repositoryPath))
+        m_provisionalMoves.remove(repositoryPath);
+}
+
+void GitVersionWorker::requeueRetrieval(const QString &repositoryPath, const Retrieval &entry, int cancellations,
+                                        const Scope &scope)
+{
+    // 不可见仓库的后续检索同样按耗时限速，持续变化的后台仓库不能连续占用线程池
+    const bool urgent { entry.urgent || isVisible(repositoryPath) };
+    if (!urgent) {
+        const qint64 delay { backgroundDelay(repositoryPath) };
+        if (delay > 0) {
+            deferRetrieval(repositoryPath, delay, scope);
+            return;
+        }
+    }
+    startRetrieval(repositoryPath, entry.navigationOnly, urgent, cancellations, scope);
+}
 
-    if (!Global::Cache::instance().allRepositoryPaths().contains(repositoryPath))
+void GitVersionWorker::publish(GitDirectoryStateTree &tree, Global::VersionDelta &delta)
+{
+    const QString &repositoryPath { tree.repositoryPath() };
+    const Global::RepositorySnapshotPtr &snapshot { Global::Cache::instance().snapshot(repositoryPath) };
+    if (!snapshot)
         emit newRepositoryAdded(repositoryPath);
 
-    // reset version
-    Global::Cache::instance().resetVersion(repositoryPath, versionInfoHash);
+    // 聚合树与缓存快照同步时只发布变化部分，否则整表重置
+    if (snapshot && snapshot->generation() == tree.generation()) {
+        if (delta.isEmpty())
+            return;
+        delta.generation = tree.generation() + 1;
+        if (Global::Cache::instance().applyDelta(delta)) {
+            tree.setGeneration(delta.generation);
+            persistSnapshot(repositoryPath);
+            return;
+        }
+    }
+
+    // 快照不存在、来自磁盘或已被其他写者更新
+    tree.setGeneration(Global::Cache::instance().resetVersion(repositoryPath, tree.toVersionHash()));
+    persistSnapshot(repositoryPath);
+}
+
+void GitVersionWorker::onPruneSnapshots()
+{
+    GitSnapshotStore::prune(MAX_STORED_SNAPSHOTS, MAX_SNAPSHOT_AGE_DAYS);
+}
+
+void GitVersionWorker::restoreSnapshot(const QString &repositoryPath)
+{
+    // 每个仓库只在首次进入时尝试一次，已有实时结果的仓库不需要
+    if (m_trees.contains(repositoryPath) || m_restoreAttempted.contains(repositoryPath))
+        return;
+    m_restoreAttempted.insert(repositoryPath);
+    if (Global::Cache::instance().snapshot(repositoryPath))
+        return;
+
+    // 键不匹配说明仓库在插件未运行期间变化过，旧快照不再展示
+    auto table { GitSnapshotStore::load(repositoryPath, GitSnapshotStore::repositoryKey(repositoryPath)) };
+    if (!table)
+        return;
+
+    auto snapshot { std::make_shared<const Global::RepositorySnapshot>(repositoryPath, std::move(table)) };
+    if (!Global::Cache::instance().restoreSnapshot(std::move(snapshot)))
+        return;
+
+    // 先展示，随后的导航检索完成后替换
+    qInfo() << "INFO: [GitVersionWorker] Restored persisted snapshot:" << repositoryPath;
+    emit newRepositoryAdded(repositoryPath);
+}
+
+void GitVersionWorker::persistSnapshot(const QString &repositoryPath)
+{
+    // 暂定的改名结果不写盘，确认后的下一次发布再保存
+    if (m_provisionalMoves.contains(repositoryPath))
+        return;
+
+    const qint64 now { QDateTime::currentMSecsSinceEpoch() };
+    auto it = m_lastPersisted.constFind(repositoryPath);
+    if (it != m_lastPersisted.constEnd() && now - it.value() < SNAPSHOT_SAVE_INTERVAL_MS)
+        return;
+
+    const Global::RepositorySnapshotPtr &snapshot { Global::Cache::instance().snapshot(repositoryPath) };
+    if (snapshot && GitSnapshotStore::save(*snapshot))
+        m_lastPersisted.insert(repositoryPath, now);
 }
 
 GitVersionController::GitVersionController()
@@ -168,11 +739,24 @@ GitVersionController::GitVersionController()
 
     qInfo() << "INFO: [GitVersionController] Initializing with real-time file system monitoring";
 
-    GitVersionWorker *worker { new GitVersionWorker };
+    m_worker = new GitVersionWorker;
+    GitVersionWorker *worker { m_worker };
     worker->moveToThread(&m_thread);
     connect(&m_thread, &QThread::finished, worker, &QObject::deleteLater);
     connect(this, &GitVersionController::requestRetrieval,
             worker, &GitVersionWorker::onRetrieval, Qt::QueuedConnection);
+    connect(this, &GitVersionController::requestImmediateRetrieval,
+            worker, &GitVersionWorker::onImmediateRetrieval, Qt::QueuedConnection);
+    connect(this, &GitVersionController::requestChangeRetrieval,
+            worker, &GitVersionWorker::onRepositoryChanged, Qt::QueuedConnection);
+    connect(this, &GitVersionController::requestMoveUpdate,
+            worker, &GitVersionWorker::onPathsMoved, Qt::QueuedConnection);
+    connect(this, &GitVersionController::requestNavigation,
+            worker, &GitVersionWorker::onNavigation, Qt::QueuedConnection);
+    connect(this, &GitVersionController::requestWindowLeft,
+            worker, &GitVersionWorker::onWindowLeft, Qt::QueuedConnection);
+    connect(this, &GitVersionController::requestPruneSnapshots,
+            worker, &GitVersionWorker::onPruneSnapshots, Qt::QueuedConnection);
     connect(worker, &GitVersionWorker::newRepositoryAdded,
             this, &GitVersionController::onNewRepositoryAdded, Qt::QueuedConnection);
 
@@ -185,6 +769,10 @@ GitVersionController::GitVersionController()
         m_fileSystemWatcher = new GitFileSystemWatcher(this);
         connect(m_fileSystemWatcher, &GitFileSystemWatcher::repositoryChanged,
                 this, &GitVersionController::onRepositoryChanged, Qt::QueuedConnection);
+        connect(m_fileSystemWatcher, &GitFileSystemWatcher::repositoryPathsMoved,
+                this, &GitVersionController::onRepositoryPathsMoved, Qt::QueuedConnection);
+        connect(worker, &GitVersionWorker::statusCostMeasured,
+                m_fileSystemWatcher, &GitFileSystemWatcher::setStatusCost, Qt::QueuedConnection);
 
         qInfo() << "INFO: [GitVersionController] Real-time file system watcher enabled";
     }
@@ -198,6 +786,68 @@ GitVersionController::~GitVersionController()
     m_thread.wait(3000);
 }
 
+void GitVersionController::retrieveDirectory(quint64 winId, const QUrl &url)
+{
+    // 新的导航使该窗口之前尚未处理的导航请求全部过期
+    const quint64 serial { m_worker->beginNavigation(winId) };
+
+    // 缓存中保存的是整个仓库的结果并由文件监控保持最新，
+    // 在同一仓库内切换目录时无需重新检索
+    const QString &directory { url.toLocalFile() };
+    updateVisibleRepository(winId, GitRepositoryResolver::instance().repositoryRoot(directory));
+    const QString &repositoryPath { Global::Cache::instance().findRepository(directory) };
+    if (!repositoryPath.isEmpty() && m_fileSystemWatcher && m_fileSystemWatcher->isWatching(repositoryPath)
+        && !containsNestedRepository(repositoryPath, directory)) {
+        qDebug() << "[GitVersionController] Reusing cached status of repository:" << repositoryPath
+                 << "for directory:" << directory;
+        emit requestNavigation(winId, serial, url, false);
+        return;
+    }
+
+    emit requestNavigation(winId, serial, url, true);
+}
+
+void GitVersionController::leaveDirectory(quint64 winId)
+{
+    m_worker->endNavigation(winId);
+    updateVisibleRepository(winId, QString());
+    emit requestWindowLeft(winId);
+}
+
+void GitVersionController::updateVisibleRepository(quint64 winId, const QString &repositoryPath)
+{
+    const QString &previous { m_windowRepositories.value(winId) };
+    if (previous == repositoryPath)
+        return;
+    if (repositoryPath.isEmpty())
+        m_windowRepositories.remove(winId);
+    else
+        m_windowRepositories.insert(winId, repositoryPath);
+
+    // 可见的仓库优先获得监控配额
+    if (!m_fileSystemWatcher)
+        return;
+    QSet<QString> visible;
+    for (auto it = m_windowRepositories.cbegin(); it != m_windowRepositories.cend(); ++it)
+        visible.insert(it.value());
+    m_fileSystemWatcher->setVisibleRepositories(visible);
+}
+
+bool GitVersionController::containsNestedRepository(const QString &repositoryPath, const QString &directory) const
+{
+    // 从目录向上检查到已知仓库为止，发现 .git 说明进入了尚未检索过的嵌套仓库
+    QString current { directory };
+    while (current.size() > repositoryPath.size()) {
+        if (Utils::isGitRepositoryRoot(current))
+            return true;
+        const int slash { current.lastIndexOf('/') };
+        if (slash <= 0)
+            break;
+        current.truncate(slash);
+    }
+    return false;
+}
+
 void GitVersionController::onNewRepositoryAdded(const QString &path)
 {
     qInfo() << "INFO: [GitVersionController] New repository added:" << path;
@@ -231,32 +881,65 @@ void GitVersionController::onTimeout()
 
     const auto &paths { Global::Cache::instance().allRepositoryPaths() };
     std::for_each(paths.begin(), paths.end(), [this](const auto &path) {
+        if (!needsPeriodicRetrieval(path))
+            return;
         const QUrl &url { QUrl::fromLocalFile(path) };
         if (url.isValid())
             emit requestRetrieval(url);
     });
 }
 
-void GitVersionController::onRepositoryChanged(const QString &repositoryPath)
+bool GitVersionController::needsPeriodicRetrieval(const QString &repositoryPath)
 {
-    qInfo() << "INFO: [GitVersionController] Repository changed detected:" << repositoryPath;
+    // 先做廉价探测：index、HEAD 都没变且监控器没有观察到事件时跳过完整的 git status。
+    // 配额不足（Partial/MetadataOnly）的仓库看不到未监控目录的事件：可见的每次都完整检索，
+    // 不可见的由每 MAX_SKIPPED_TICKS 次的完整检索以及重新可见时的升级检索补上
+    const Utils::RepositoryFingerprint &fingerprint { Utils::readRepositoryFingerprint(repositoryPath) };
+    bool dirty { !m_fileSystemWatcher || m_fileSystemWatcher->takeDirty(repositoryPath) };
+    if (!dirty) {
+        const GitWatchBudget::Allocation &allocation { m_fileSystemWatcher->watchAllocation(repositoryPath) };
+        dirty = allocation.visible && (allocation.level != GitWatchBudget::Level::Full || !allocation.complete);
+    }
 
-    // 立即触发状态更新
-    const QUrl &url { QUrl::fromLocalFile(repositoryPath) };
-    if (url.isValid()) {
-        emit requestRetrieval(url);
-        qDebug() << "[GitVersionController] Triggered immediate update for repository:" << repositoryPath;
+    auto it = m_fingerprints.find(repositoryPath);
+    if (it != m_fingerprints.end() && !dirty && it->fingerprint == fingerprint
+        && it->skippedTicks < MAX_SKIPPED_TICKS) {
+        ++it->skippedTicks;
+        qDebug() << "[GitVersionController] Repository unchanged, skipping periodic retrieval:" << repositoryPath;
+        return false;
     }
+
+    // 监控器可能漏掉事件（超出监控上限的文件等），每隔若干次仍完整检索一遍
+    m_fingerprints.insert(repositoryPath, ProbeState { fingerprint, 0 });
+    return true;
+}
+
+void GitVersionController::onRepositoryChanged(const QString &repositoryPath, int changes, const QStringList &paths)
+{
+    qInfo() << "INFO: [GitVersionController] Repository changed detected:" << repositoryPath
+            << "changes:" << changes << "paths:" << paths.size();
+
+    // 由调度器按变化类别选择刷新方式
+    emit requestChangeRetrieval(repositoryPath, changes, paths);
+}
+
+void GitVersionController::onRepositoryPathsMoved(const QString &repositoryPath, const QStringList &sources,
+                                                  const QStringList &targets)
+{
+    qDebug() << "[GitVersionController] Paths moved in repository:" << repositoryPath << "count:" << sources.size();
+
+    // 立即迁移缓存中的记录，确认检索由随后的 repositoryChanged 触发
+    emit requestMoveUpdate(repositoryPath, sources, targets);
 }
 
 void GitVersionController::onRepositoryUpdateRequested(const QString &repositoryPath)
 {
     qInfo() << "INFO: [GitVersionController] Repository update requested from service:" << repositoryPath;
 
-    // 通过服务请求触发状态更新
+    // 通过服务请求触发状态更新（用户操作的结果，不受后台限速）
     const QUrl &url { QUrl::fromLocalFile(repositoryPath) };
     if (url.isValid()) {
-        emit requestRetrieval(url);
+        emit requestImmediateRetrieval(url);
         qDebug() << "[GitVersionController] Triggered service-requested update for repository:" << repositoryPath;
     }
 }
@@ -276,14 +959,17 @@ GitWindowPlugin::GitWindowPlugin()
 
 void GitWindowPlugin::windowUrlChanged(std::uint64_t winId, const std::string &urlString)
 {
-    Q_UNUSED(winId)
     const QUrl &url { QString::fromStdString(urlString) };
-    if (!url.isValid() || !url.isLocalFile())
+    if (!url.isValid() || !url.isLocalFile()) {
+        // 进入回收站等非本地目录，之前的导航请求不再需要
+        if (m_controller)
+            m_controller->leaveDirectory(winId);
         return;
+    }
 
     if (!m_controller)
         m_controller.reset(new GitVersionController);
-    emit m_controller->requestRetrieval(url);
+    m_controller->retrieveDirectory(winId, url);
 
     // TODO: remove ignroed dir
 }
@@ -293,9 +979,15 @@ void GitWindowPlugin::firstWindowOpened(uint64_t winId)
     Q_UNUSED(winId)
     if (!m_controller)
         m_controller.reset(new GitVersionController);
+
+    // 快照在首次进入仓库时按需加载，这里只清理长期未使用的快照
+    emit m_controller->requestPruneSnapshots();
 }
 
 void GitWindowPlugin::windowClosed(std::uint64_t winId)
 {
+    if (m_controller)
+        m_controller->leaveDirectory(winId);
+
     // TODO: release memory
 }
@@ -4,20 +4,192 @@
 #include <dfm-extension/window/dfmextwindowplugin.h>
 
 #include <QString>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
 #include <QThread>
 #include <QTimer>
 
+#include <memory>
+
+#include <repositorysnapshot.h>
+
+#include "utils.h"
+
+class QThreadPool;
 class GitFileSystemWatcher;
+struct RetrievalControl;
+class GitDirectoryStateTree;
 
+/**
+ * @brief 状态检索调度器
+ *
+ * 运行在 GitVersionController 的工作线程上，负责把检索请求分派到有界线程池中执行
+ * `git status`，并在本线程上串行地更新聚合树、发布到缓存。
+ * 不同仓库可以并行检索，同一仓库同一时间最多只有一个 `git status` 在运行。
+ * 窗口中可见的仓库优先执行，不可见仓库的后台刷新按上次检索耗时限速。
+ * 文件监控报告的变化按类别选择最廉价的刷新：工作区变化只检索变化的路径并按增量发布，
+ * 引用与 fetch 变化只刷新分支信息，index、配置或 HEAD 指向的提交变化时才完整检索。
+ * 改名时先把原路径下的记录迁移到新路径并立即发布，作为暂定结果，等两端路径的检索完成后确认。
+ */
 class GitVersionWorker : public QObject
 {
     Q_OBJECT
+    friend class GitStatusJob;
+    friend class GitInfoJob;
+
+public:
+    GitVersionWorker();
+    ~GitVersionWorker() override;
+
+    /**
+     * @brief 检索请求统计，用于观察请求合并的效果
+     *
+     * 只在检索线程上读写，工作线程结束时输出到日志。
+     */
+    struct Statistics
+    {
+        quint64 requests { 0 };   ///< 收到的检索请求数
+        quint64 retrievals { 0 };   ///< 实际执行的 git status 次数
+        quint64 coalesced { 0 };   ///< 被合并掉的请求数
+        quint64 cancelled { 0 };   ///< 因新请求而中止的 git status 次数
+        quint64 droppedNavigations { 0 };   ///< 窗口离开目录后丢弃的导航请求数
+        quint64 promoted { 0 };   ///< 仓库变为可见后提升优先级的检索数
+        quint64 deferred { 0 };   ///< 因后台限速被推迟的请求数
+        quint64 pathLimited { 0 };   ///< 按路径限定执行的 git status 次数
+        quint64 metadataOnly { 0 };   ///< 只刷新分支信息、未检索状态的变化数
+        quint64 movedPaths { 0 };   ///< 按改名事件预先迁移的路径数
+    };
+
+    /**
+     * @brief 检索线程数：默认按 CPU 核数，可用环境变量 DFM_GIT_STATUS_WORKERS 覆盖
+     */
+    static int workerCount();
+
+    /**
+     * @brief 窗口切换目录时在界面线程调用，返回本次导航的序号（线程安全）
+     * @param winId 窗口 id
+     * @return 序号，随导航请求一起投递，过期的请求在调度时丢弃
+     */
+    quint64 beginNavigation(quint64 winId);
+
+    /**
+     * @brief 窗口关闭或进入非本地目录时调用，使该窗口所有未处理的导航请求失效（线程安全）
+     * @param winId 窗口 id
+     */
+    void endNavigation(quint64 winId);
 
 Q_SIGNALS:
     void newRepositoryAdded(const QString &path);
+    void statusCostMeasured(const QString &repositoryPath, qint64 cost);   ///< 完整检索完成，用于调整文件监控的防抖窗口
 
 public Q_SLOTS:
-    void onRetrieval(const QUrl &url);
+    void onRetrieval(const QUrl &url);   ///< 后台刷新：不可见的仓库按检索耗时限速
+    void onImmediateRetrieval(const QUrl &url);   ///< 用户操作后的刷新：不限速、高优先级
+    void onRepositoryChanged(const QString &repositoryPath, int changes, const QStringList &paths);   ///< 文件监控报告的变化
+    void onPathsMoved(const QString &repositoryPath, const QStringList &sources, const QStringList &targets);   ///< 文件监控报告的改名
+    void onNavigation(quint64 winId, quint64 serial, const QUrl &url, bool retrieve);
+    void onWindowLeft(quint64 winId);
+    void onPruneSnapshots();   ///< 清理长期未使用的磁盘快照
+
+private:
+    enum class RequestKind {
+        Navigation,   ///< 窗口进入目录
+        Immediate,   ///< 用户操作后需要立即刷新
+        Background   ///< 文件监控、定时器等后台刷新
+    };
+
+    /**
+     * @brief 分支信息的刷新程度
+     */
+    enum class InfoRefresh {
+        None,
+        Tracking,   ///< 只刷新领先/落后计数
+        Branch   ///< 重新读取分支并刷新上游
+    };
+
+    /**
+     * @brief 检索范围：整个仓库，或相对仓库根目录的若干路径
+     */
+    struct Scope
+    {
+        bool full { true };
+        QSet<QString> paths;   ///< full 为 false 时有效
+
+        bool covers(const Scope &other) const;
+        void merge(const Scope &other);   ///< 合并后路径过多时退化为整个仓库
+    };
+
+    /**
+     * @brief 仓库检索状态，不在表中即为空闲
+     *
+     * Idle --请求--> Running --请求--> Dirty（检索期间又有变化，不论多少次请求都只记一次）
+     * Running --完成--> Idle；Dirty --完成--> Running（再检索一次以包含期间的变化）
+     * 任务还在线程池队列中、git status 尚未启动时到达的请求直接合并，不会标记 Dirty。
+     * 标记 Dirty 时若 git status 刚开始不久则直接中止，由下一代检索取代。
+     */
+    struct Retrieval
+    {
+        std::shared_ptr<RetrievalControl> control;
+        quint64 generation { 0 };   ///< 检索代数，只接受当前代的结果
+        int cancellations { 0 };   ///< 连续被中止的次数
+        Scope scope;   ///< 本次检索的范围
+        Scope pending;   ///< Dirty 期间累积的范围，完成后据此再检索
+        bool dirty { false };
+        bool navigationOnly { false };   ///< 仅由窗口导航触发，窗口离开后可以丢弃
+        bool urgent { false };   ///< 以高优先级排队
+    };
+
+    void request(const QString &repositoryPath, RequestKind kind, const Scope &scope = Scope());
+    void refreshInfo(const QString &repositoryPath, InfoRefresh refresh);
+    void onInfoRefreshed(const QString &repositoryPath);
+    bool isVisible(const QString &repositoryPath) const;
+    qint64 backgroundDelay(const QString &repositoryPath) const;
+    void deferRetrieval(const QString &repositoryPath, qint64 delay, const Scope &scope);
+    void dropNavigationRetrieval(const QString &repositoryPath);
+    bool isCurrentNavigation(quint64 winId, quint64 serial) const;
+    void startRetrieval(const QString &repositoryPath, bool navigation, bool urgent, int cancellations,
+                        Scope scope = Scope());
+    void requeueRetrieval(const QString &repositoryPath, const Retrieval &entry, int cancellations,
+                          const Scope &scope = Scope());
+    void onRetrievalFinished(const QString &repositoryPath, quint64 generation, bool completed,
+                             qint64 cost, const QHash<QString, Global::ItemVersion> &fileStates);
+    void publish(GitDirectoryStateTree &tree, Global::VersionDelta &delta);
+    void confirmMoves(const QString &repositoryPath, const Scope &scope);
+    void persistSnapshot(const QString &repositoryPath);
+    void restoreSnapshot(const QString &repositoryPath);
+
+    QThreadPool *m_pool { nullptr };   ///< 执行 git status 的线程池
+    QHash<QString, Retrieval> m_retrievals;   ///< repository path -> 检索状态
+    QHash<QString, qint64> m_statusCosts;   ///< repository path -> 上次完整检索耗时（毫秒）
+    QHash<QString, InfoRefresh> m_infoRefreshes;   ///< repository path -> 刷新分支信息期间又到达的请求
+    QHash<QString, Utils::RepositoryFingerprint> m_fullFingerprints;   ///< repository path -> 上次完整检索时的元数据指纹
+    QHash<QString, qint64> m_lastFinished;   ///< repository path -> 上次检索完成时间
+    QHash<QString, Scope> m_deferred;   ///< 已安排延迟刷新的仓库 -> 累积的检索范围
+    QHash<quint64, QString> m_windowRepositories;   ///< 窗口 -> 当前所在仓库
+    quint64 m_nextGeneration { 0 };
+    Statistics m_statistics;
+    QHash<QString, std::shared_ptr<GitDirectoryStateTree>> m_trees;   // repository path -> 目录状态聚合树
+    QHash<QString, qint64> m_lastPersisted;   // repository path -> 上次写盘时间
+    QSet<QString> m_restoreAttempted;   ///< 已尝试加载磁盘快照的仓库
+    QHash<QString, QSet<QString>> m_provisionalMoves;   ///< repository path -> 按改名迁移、尚未经检索确认的相对路径
+
+    mutable QMutex m_navigationMutex;   ///< 保护导航序号，界面线程与调度线程共用
+    QHash<quint64, quint64> m_navigationSerials;   ///< 窗口 -> 最新导航序号
+    quint64 m_lastNavigationSerial { 0 };
+
+    static constexpr qint64 SNAPSHOT_SAVE_INTERVAL_MS = 60000;   ///< 同一仓库的最短写盘间隔
+    static constexpr int MAX_STORED_SNAPSHOTS = 64;   ///< 磁盘上保留的快照数，按最近写入时间淘汰
+    static constexpr int MAX_SNAPSHOT_AGE_DAYS = 30;   ///< 超过该天数未写入的快照被删除
+    static constexpr int MAX_STATUS_WORKERS = 8;   ///< 默认检索线程数上限
+    static constexpr int MAX_CONFIGURED_WORKERS = 32;   ///< 环境变量可配置的上限
+    static constexpr int MAX_CONSECUTIVE_CANCELLATIONS = 2;   ///< 连续中止次数上限，之后让检索完成
+    static constexpr int URGENT_PRIORITY = 1;   ///< 可见仓库在线程池中的优先级
+    static constexpr int BACKGROUND_PRIORITY = 0;
+    static constexpr qint64 BACKGROUND_COST_FACTOR = 10;   ///< 后台刷新间隔 = 检索耗时 * 该系数
+    static constexpr qint64 MIN_BACKGROUND_INTERVAL_MS = 1000;
+    static constexpr qint64 MAX_BACKGROUND_INTERVAL_MS = 60000;
+    static constexpr int MAX_PATHSPEC_SIZE = 256;   ///< 按路径检索的路径数上限，超过则完整检索
 };
 
 class GitVersionController : public QObject
@@ -28,20 +200,55 @@ public:
     GitVersionController();
     ~GitVersionController();
 
+    /**
+     * @brief 窗口切换到新目录时请求检索，同一仓库内的目录复用已有结果
+     * @param winId 窗口 id
+     * @param url 目录地址
+     */
+    void retrieveDirectory(quint64 winId, const QUrl &url);
+
+    /**
+     * @brief 窗口关闭或离开本地目录，丢弃该窗口尚未处理的导航请求
+     * @param winId 窗口 id
+     */
+    void leaveDirectory(quint64 winId);
+
 Q_SIGNALS:
     void requestRetrieval(const QUrl &url);
+    void requestImmediateRetrieval(const QUrl &url);
+    void requestChangeRetrieval(const QString &repositoryPath, int changes, const QStringList &paths);
+    void requestMoveUpdate(const QString &repositoryPath, const QStringList &sources, const QStringList &targets);
+    void requestNavigation(quint64 winId, quint64 serial, const QUrl &url, bool retrieve);
+    void requestWindowLeft(quint64 winId);
+    void requestPruneSnapshots();
 
 private Q_SLOTS:
     void onNewRepositoryAdded(const QString &path);
     void onTimeout();
-    void onRepositoryChanged(const QString &repositoryPath);
+    void onRepositoryChanged(const QString &repositoryPath, int changes, const QStringList &paths);
+    void onRepositoryPathsMoved(const QString &repositoryPath, const QStringList &sources, const QStringList &targets);
     void onRepositoryUpdateRequested(const QString &repositoryPath);
 
 private:
+    bool containsNestedRepository(const QString &repositoryPath, const QString &directory) const;
+    bool needsPeriodicRetrieval(const QString &repositoryPath);
+    void updateVisibleRepository(quint64 winId, const QString &repositoryPath);
+
+    struct ProbeState
+    {
+        Utils::RepositoryFingerprint fingerprint;
+        int skippedTicks { 0 };   ///< 连续跳过的定时检索次数
+    };
+
     QThread m_thread;
+    GitVersionWorker *m_worker { nullptr };
     QTimer *m_timer { nullptr };
     GitFileSystemWatcher *m_fileSystemWatcher { nullptr };
     bool m_useFileSystemWatcher { true };
+    QHash<QString, ProbeState> m_fingerprints;   ///< repository path -> 上次定时检索时的元数据指纹
+    QHash<quint64, QString> m_windowRepositories;   ///< 窗口 -> 当前所在仓库，用于分配监控配额
+
+    static constexpr int MAX_SKIPPED_TICKS = 10;   ///< 最多连续跳过的定时检索次数
 };
 
 class GitWindowPlugin : public DFMEXT::DFMExtWindowPlugin
@@ -1,11 +1,23 @@
 #include "utils.h"
 
 #include <QProcess>
-#include <QUrl>
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QDebug>
+
+#include <cstring>
+#include <memory>
 
 #include <cache.h>
 
+#include "gitrepositoryresolver.h"
+#include "gitrepositoryinfo.h"
+
 namespace Utils {
 
 // 递归辅助函数的前向声明
@@ -56,77 +68,31 @@ bool isDirectoryEmptyRecursive(const QString &path, int remainingDepth)
 
 QString repositoryBaseDir(const QString &directory)
 {
-    QProcess process;
-    process.setWorkingDirectory(directory);
-    process.start("git", { "rev-parse", "--show-toplevel" });
-    if (process.waitForFinished(1000) && process.exitCode() == 0)
-        return QString::fromUtf8(process.readAll().chopped(1));
-    return QString();
+    return GitRepositoryResolver::instance().repositoryRoot(directory);
 }
 
 QString findPathBelowGitBaseDir(const QString &directory)
 {
-    QProcess process;
-    process.setWorkingDirectory(directory);
-    process.start("git", { "rev-parse", "--show-prefix" });
-    QString dirBelowBaseDir;
-    while (process.waitForReadyRead()) {
-        char buffer[512];
-        while (process.readLine(buffer, sizeof(buffer)) > 0) {
-            dirBelowBaseDir = QString(buffer).trimmed();   // ends in "/" or is empty
-        }
-    }
-    return dirBelowBaseDir;
+    // 与 `git rev-parse --show-prefix` 一致：以 "/" 结尾，位于根目录时为空
+    const QString &repositoryPath { repositoryBaseDir(directory) };
+    if (repositoryPath.isEmpty())
+        return QString();
+
+    const QString &relativePath { QDir(repositoryPath).relativeFilePath(directory) };
+    if (relativePath.isEmpty() || relativePath == QLatin1String("."))
+        return QString();
+    return relativePath + '/';
 }
 
 bool isInsideRepositoryDir(const QString &directory)
 {
-    QProcess process;
-    process.setWorkingDirectory(directory);
-    process.start("git", { "rev-parse", "--is-inside-work-tree" });
-    if (process.waitForFinished(1000) && process.exitCode() == 0)
-        return true;
-    return false;
+    return !repositoryBaseDir(directory).isEmpty();
 }
 
 bool isInsideRepositoryFile(const QString &path)
 {
-    const auto &repositoryPaths { Global::Cache::instance().allRepositoryPaths() };
-    return std::any_of(repositoryPaths.begin(), repositoryPaths.end(), [&path](const auto &repositoryPath) {
-        return path.startsWith(repositoryPath + "/");
-    });
-}
-
-int readUntilZeroChar(QIODevice *device, char *buffer, const int maxChars)
-{
-    if (buffer == nullptr) {   // discard until next \0
-        char c;
-        while (device->getChar(&c) && c != '\0')
-            ;
-        return 0;
-    }
-    int index = -1;
-    while (++index < maxChars) {
-        if (!device->getChar(&buffer[index])) {
-            if (device->waitForReadyRead(30000)) {   // 30 seconds to be consistent with QProcess::waitForReadyRead default
-                --index;
-                continue;
-            } else {
-                buffer[index] = '\0';
-                return index <= 0 ? 0 : index + 1;
-            }
-        }
-        if (buffer[index] == '\0') {   // line end or we put it there (see above)
-            return index + 1;
-        }
-    }
-    return maxChars;
-}
-
-std::tuple<char, char, QString> parseLineGitStatus(const QString &line)
-{
-    Q_ASSERT(line.size() >= 3);
-    return { line[0].toLatin1(), line[1].toLatin1(), line.mid(3) };
+    // 仅判断严格位于某个仓库内部，仓库根目录本身不算
+    return !Global::Cache::instance().findRepository(path, false).isEmpty();
 }
 
 Global::ItemVersion parseXYState(Global::ItemVersion state, char X, char Y)
@@ -162,20 +128,6 @@ Global::ItemVersion parseXYState(Global::ItemVersion state, char X, char Y)
     return state;
 }
 
-QStringList makeDirGroup(const QString &directory, const QString &relativeFileName)
-{
-    Q_ASSERT(relativeFileName.contains("/"));
-    Q_ASSERT(QUrl::fromLocalFile(directory).isValid());
-
-    QStringList group;
-    int index = relativeFileName.indexOf('/');
-    while (index != -1) {
-        group.append(directory + "/" + relativeFileName.left(index));
-        index = relativeFileName.indexOf('/', index + 1);
-    }
-    return group;
-}
-
 bool isDirectoryEmpty(const QString &path)
 {
     QDir directory(path);
@@ -220,19 +172,6 @@ bool isDirectoryEmpty(const QString &path)
     return true;
 }
 
-bool isIgnoredDirectory(const QString &directory, const QString &path)
-{
-    QProcess process;
-    process.setWorkingDirectory(directory);
-    process.start("git", { "check-ignore", "-v", path });
-    if (process.waitForFinished(1000) && process.exitCode() == 0) {
-        const QString &result { QString::fromUtf8(process.readAll().chopped(1)) };
-        return result.startsWith(".ignore");
-    }
-
-    return false;
-}
-
 bool isGitRepositoryRoot(const QString &directoryPath)
 {
     // 轻量级检测：检查 .git 目录是否存在
@@ -248,6 +187,260 @@ bool isGitRepositoryRoot(const QString &directoryPath)
     return gitInfo.exists() && (gitInfo.isDir() || gitInfo.isFile());
 }
 
+QString gitDirectory(const QString &repositoryPath)
+{
+    const QString dotGit { repositoryPath + "/.git" };
+    QFileInfo info(dotGit);
+    if (info.isDir())
+        return dotGit;
+    if (!info.isFile())
+        return QString();
+
+    // worktree 和 submodule 中 .git 是一个文件："gitdir: <path>"
+    QFile file(dotGit);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+    const QByteArray &content { file.readLine().trimmed() };
+    if (!content.startsWith("gitdir:"))
+        return QString();
+
+    const QString &gitDir { QString::fromUtf8(content.mid(7).trimmed()) };
+    return QDir::cleanPath(QDir(repositoryPath).absoluteFilePath(gitDir));
+}
+
+QString gitCommonDirectory(const QString &gitDir)
+{
+    QFile file(gitDir + "/commondir");
+    if (!file.open(QIODevice::ReadOnly))
+        return gitDir;
+
+    const QString &commonDir { QString::fromUtf8(file.readLine().trimmed()) };
+    if (commonDir.isEmpty())
+        return gitDir;
+    return QDir::cleanPath(QDir(gitDir).absoluteFilePath(commonDir));
+}
+
+namespace {
+QByteArray readRefTarget(const QString &gitDir, const QString &commonDir, QByteArray ref)
+{
+    // 跟随符号引用，限制深度防止循环
+    for (int depth = 0; depth < 5; ++depth) {
+        if (!ref.startsWith("ref:"))
+            return ref;
+
+        const QByteArray &refName { ref.mid(4).trimmed() };
+        // HEAD 等伪引用位于各自 worktree 的 git 目录，其余引用位于共享目录
+        const QString &baseDir { refName.startsWith("refs/") ? commonDir : gitDir };
+        QFile looseRef(baseDir + "/" + QString::fromUtf8(refName));
+        if (looseRef.open(QIODevice::ReadOnly)) {
+            ref = looseRef.readAll().trimmed();
+            continue;
+        }
+
+        QFile packedRefs(commonDir + "/packed-refs");
+        if (!packedRefs.open(QIODevice::ReadOnly))
+            return QByteArray();
+
+        ref.clear();
+        while (!packedRefs.atEnd()) {
+            const QByteArray &line { packedRefs.readLine().trimmed() };
+            if (line.startsWith('#') || line.startsWith('^'))
+                continue;
+            const int space { line.indexOf(' ') };
+            if (space > 0 && line.mid(space + 1) == refName) {
+                ref = line.left(space);
+                break;
+            }
+        }
+        return ref;
+    }
+    return QByteArray();
+}
+}   // namespace
+
+QByteArray readHeadOid(const QString &repositoryPath)
+{
+    const QString &gitDir { gitDirectory(repositoryPath) };
+    if (gitDir.isEmpty())
+        return QByteArray();
+
+    QFile head(gitDir + "/HEAD");
+    if (!head.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    return readRefTarget(gitDir, gitCommonDirectory(gitDir), head.readAll().trimmed());
+}
+
+QByteArray readIndexChecksum(const QString &repositoryPath)
+{
+    const QString &gitDir { gitDirectory(repositoryPath) };
+    if (gitDir.isEmpty())
+        return QByteArray();
+
+    QFile index(gitDir + "/index");
+    if (!index.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    // 索引文件以内容的哈希结尾：SHA-1 为 20 字节，SHA-256 仓库为 32 字节
+    const int checksumBytes { readHeadOid(repositoryPath).size() == 64 ? 32 : 20 };
+    if (index.size() < checksumBytes || !index.seek(index.size() - checksumBytes))
+        return QByteArray();
+    return index.read(checksumBytes).toHex();
+}
+
+RepositoryFingerprint readRepositoryFingerprint(const QString &repositoryPath)
+{
+    RepositoryFingerprint fingerprint;
+    const QString &gitDir { gitDirectory(repositoryPath) };
+    if (gitDir.isEmpty())
+        return fingerprint;
+
+    const QFileInfo index(gitDir + "/index");
+    if (index.exists()) {
+        fingerprint.indexModified = index.lastModified().toMSecsSinceEpoch();
+        fingerprint.indexSize = index.size();
+    }
+
+    QFile head(gitDir + "/HEAD");
+    if (head.open(QIODevice::ReadOnly)) {
+        fingerprint.head = head.readAll().trimmed();
+        fingerprint.headOid = readRefTarget(gitDir, gitCommonDirectory(gitDir), fingerprint.head);
+    }
+    return fingerprint;
+}
+
+namespace {
+/**
+ * @brief 解析 index，收集所有被跟踪文件的上级目录（相对仓库根目录）
+ *
+ * 支持 v2/v3/v4 格式与稀疏索引的目录条目；split index 的条目不全在主文件中，
+ * 与无法识别的格式一样返回空指针，由调用方保守处理。
+ */
+std::shared_ptr<const QSet<QString>> readTrackedDirectories(const QString &indexPath, int oidBytes)
+{
+    QFile file(indexPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+    const QByteArray &data { file.readAll() };
+    const char *cursor { data.constData() };
+    const char *end { cursor + data.size() - oidBytes };   // 末尾是整个文件的校验和
+    auto readUInt32 = [](const char *p) {
+        const auto *bytes { reinterpret_cast<const uchar *>(p) };
+        return (quint32(bytes[0]) << 24) | (quint32(bytes[1]) << 16) | (quint32(bytes[2]) << 8) | quint32(bytes[3]);
+    };
+
+    if (end - cursor < 12 || std::memcmp(cursor, "DIRC", 4) != 0)
+        return nullptr;
+    const quint32 version { readUInt32(cursor + 4) };
+    const quint32 entryCount { readUInt32(cursor + 8) };
+    if (version < 2 || version > 4)
+        return nullptr;
+    cursor += 12;
+
+    auto directories { std::make_shared<QSet<QString>>() };
+    QByteArray path;   // v4 的路径相对上一条目做前缀压缩
+    const int fixedBytes { 40 + oidBytes + 2 };   // stat 信息、对象 id、flags
+    for (quint32 i = 0; i < entryCount; ++i) {
+        const char *entry { cursor };
+        if (end - cursor < fixedBytes)
+            return nullptr;
+        const auto flags { static_cast<quint16>((uchar(cursor[fixedBytes - 2]) << 8) | uchar(cursor[fixedBytes - 1])) };
+        cursor += fixedBytes;
+        if (version >= 3 && (flags & 0x4000))   // extended flags
+            cursor += 2;
+
+        if (version == 4) {
+            // 偏移量编码的变长整数：需要从上一条路径末尾去掉的字节数
+            if (cursor >= end)
+                return nullptr;
+            uchar byte { uchar(*cursor++) };
+            quint64 strip { byte & 0x7fu };
+            while (byte & 0x80) {
+                if (cursor >= end)
+                    return nullptr;
+                byte = uchar(*cursor++);
+                strip = ((strip + 1) << 7) | (byte & 0x7fu);
+            }
+            if (strip > quint64(path.size()))
+                return nullptr;
+            path.chop(static_cast<int>(strip));
+        } else {
+            path.clear();
+        }
+
+        const char *terminator { static_cast<const char *>(std::memchr(cursor, '\0', static_cast<std::size_t>(qMax<qint64>(0, end - cursor)))) };
+        if (!terminator)
+            return nullptr;
+        path.append(cursor, static_cast<int>(terminator - cursor));
+        cursor = terminator + 1;
+        if (version != 4)   // 条目按 8 字节对齐，以 1~8 个 NUL 结尾
+            cursor = entry + ((terminator - entry + 8) & ~qint64(7));
+
+        // 由深到浅插入上级目录，遇到已有的目录即可停止（其上级必然也已插入）
+        int slash { path.endsWith('/') ? path.size() - 1 : path.lastIndexOf('/') };
+        while (slash > 0) {
+            const QString &directory { QString::fromUtf8(path.constData(), slash) };
+            if (directories->contains(directory))
+                break;
+            directories->insert(directory);
+            slash = path.lastIndexOf('/', slash - 1);
+        }
+    }
+
+    // 扩展段：<签名><长度><数据>，"link" 表示 split index
+    while (end - cursor >= 8) {
+        if (std::memcmp(cursor, "link", 4) == 0)
+            return nullptr;
+        const quint32 size { readUInt32(cursor + 4) };
+        if (quint64(end - cursor - 8) < size)
+            return nullptr;
+        cursor += 8 + size;
+    }
+    return directories;
+}
+}   // namespace
+
+bool containsTrackedFiles(const QString &repositoryPath, const QString &relativeDir)
+{
+    // 由 index 直接判断，不启动 git；解析结果在 index 变化前一直复用
+    struct TrackedDirectories
+    {
+        qint64 indexModified { -1 };
+        qint64 indexSize { -1 };
+        std::shared_ptr<const QSet<QString>> directories;
+    };
+    static QMutex mutex;
+    static QHash<QString, TrackedDirectories> cache;
+
+    const QString &gitDir { gitDirectory(repositoryPath) };
+    if (gitDir.isEmpty())
+        return true;
+    const QFileInfo index(gitDir + "/index");
+    if (!index.exists())
+        return false;   // 还没有任何被跟踪的文件
+    const qint64 modified { index.lastModified().toMSecsSinceEpoch() };
+    const qint64 size { index.size() };
+
+    std::shared_ptr<const QSet<QString>> directories;
+    {
+        QMutexLocker locker(&mutex);
+        auto it = cache.constFind(repositoryPath);
+        if (it != cache.constEnd() && it->indexModified == modified && it->indexSize == size)
+            directories = it->directories;
+    }
+    if (!directories) {
+        const int oidBytes { readHeadOid(repositoryPath).size() == 64 ? 32 : 20 };
+        directories = readTrackedDirectories(index.filePath(), oidBytes);
+        if (!directories) {
+            qWarning() << "WARNING: [Utils] Unsupported index, assuming tracked files in:" << repositoryPath << relativeDir;
+            return true;
+        }
+        QMutexLocker locker(&mutex);
+        cache.insert(repositoryPath, TrackedDirectories { modified, size, directories });
+    }
+    return directories->contains(relativeDir);
+}
+
 Global::ItemVersion getFileGitStatus(const QString &filePath)
 {
     return Global::Cache::instance().version(filePath);
@@ -431,6 +624,11 @@ QString getFileStatusDescription(const QString &filePath)
 
 QString getBranchName(const QString &repositoryPath)
 {
+    // 被监控的仓库由状态检索调度器保持最新；分离 HEAD 时与 rev-parse --abbrev-ref 一样返回 "HEAD"
+    GitRepositoryInfo info;
+    if (GitRepositoryInfoStore::instance().info(repositoryPath, &info) && !info.branch.isEmpty())
+        return info.detached ? QStringLiteral("HEAD") : info.branch;
+
     QProcess process;
     process.setWorkingDirectory(repositoryPath);
     process.start("git", { "symbolic-ref", "--short", "HEAD" });
@@ -1,10 +1,8 @@
 #ifndef UTILS_H
 #define UTILS_H
 
-#include <tuple>
-
 #include <QString>
-#include <QIODevice>
+#include <QByteArray>
 
 #include <global.h>
 
@@ -13,14 +11,76 @@ QString repositoryBaseDir(const QString &directory);
 QString findPathBelowGitBaseDir(const QString &directory);
 bool isInsideRepositoryDir(const QString &directory);
 bool isInsideRepositoryFile(const QString &path);
-int readUntilZeroChar(QIODevice *device, char *buffer, const int maxChars);
-std::tuple<char, char, QString> parseLineGitStatus(const QString &line);
 Global::ItemVersion parseXYState(Global::ItemVersion state, char X, char Y);
-QStringList makeDirGroup(const QString &directory, const QString &relativeFileName);
 bool isDirectoryEmpty(const QString &path);
-bool isIgnoredDirectory(const QString &directory, const QString &path);
 bool isGitRepositoryRoot(const QString &directoryPath);
 
+// Git 元数据读取（直接读取 .git 下的文件，不启动 git 进程）
+/**
+ * @brief 获取仓库的 git 目录，兼容 worktree/submodule 的 "gitdir:" 文件
+ * @param repositoryPath 仓库根目录
+ * @return git 目录绝对路径，失败返回空字符串
+ */
+QString gitDirectory(const QString &repositoryPath);
+
+/**
+ * @brief 获取 refs/packed-refs 等共享数据所在的目录（worktree 的 commondir）
+ * @param gitDir git 目录
+ * @return 共享 git 目录
+ */
+QString gitCommonDirectory(const QString &gitDir);
+
+/**
+ * @brief 解析 HEAD 指向的提交 oid
+ * @param repositoryPath 仓库根目录
+ * @return 十六进制 oid，未出生的分支或解析失败返回空
+ */
+QByteArray readHeadOid(const QString &repositoryPath);
+
+/**
+ * @brief 读取 .git/index 末尾的校验和
+ * @param repositoryPath 仓库根目录
+ * @return 十六进制校验和，索引不存在时返回空
+ */
+QByteArray readIndexChecksum(const QString &repositoryPath);
+
+/**
+ * @brief 仓库元数据指纹，只需几次 stat 和小文件读取，用于廉价地判断是否需要完整检索
+ */
+struct RepositoryFingerprint
+{
+    qint64 indexModified { -1 };   ///< .git/index 修改时间（毫秒）
+    qint64 indexSize { -1 };
+    QByteArray head;   ///< HEAD 文件内容，分支切换时变化
+    QByteArray headOid;   ///< HEAD 最终指向的提交
+
+    bool operator==(const RepositoryFingerprint &other) const
+    {
+        return indexModified == other.indexModified && indexSize == other.indexSize
+                && head == other.head && headOid == other.headOid;
+    }
+    bool operator!=(const RepositoryFingerprint &other) const { return !(*this == other); }
+};
+
+/**
+ * @brief 读取仓库元数据指纹
+ * @param repositoryPath 仓库根目录
+ * @return 指纹，不是有效仓库时各字段保持默认值
+ */
+RepositoryFingerprint readRepositoryFingerprint(const QString &repositoryPath);
+
+/**
+ * @brief 目录下是否有被跟踪的文件（直接解析 .git/index，不启动 git）
+ *
+ * 忽略规则不影响已被跟踪的文件（规则添加之前就被跟踪，或被强制添加），
+ * 被忽略的目录中仍可能有需要监控的文件。每个仓库的解析结果在 index 变化前复用。
+ *
+ * @param repositoryPath 仓库根目录
+ * @param relativeDir 相对仓库根目录的目录
+ * @return 有被跟踪的文件返回 true，index 无法解析（如 split index）时保守地返回 true
+ */
+bool containsTrackedFiles(const QString &repositoryPath, const QString &relativeDir);
+
 // Git 操作状态检查函数
 bool canAddFile(const QString &filePath);
 bool canRemoveFile(const QString &filePath);
@@ -0,0 +1,182 @@
+#include "pathindex.h"
+
+#include <algorithm>
+
+namespace Global {
+
+namespace {
+
+// 逐个遍历路径组件，跳过开头和重复的 '/'
+template<typename Visitor>
+void forEachComponent(const QString &path, Visitor &&visitor)
+{
+    const int length = path.size();
+    int start = 0;
+    while (start < length) {
+        while (start < length && path.at(start) == QLatin1Char('/'))
+            ++start;
+        if (start >= length)
+            break;
+        int end = path.indexOf(QLatin1Char('/'), start);
+        if (end < 0)
+            end = length;
+        if (!visitor(QStringView(path).mid(start, end - start), end >= length))
+            return;
+        start = end + 1;
+    }
+}
+
+}   // namespace
+
+PathIndex::PathIndex()
+{
+    m_nodes.emplace_back();   // 根节点对应 "/"
+}
+
+void PathIndex::insert(const QString &path)
+{
+    if (path.isEmpty())
+        return;
+
+    int node = 0;
+    forEachComponent(path, [this, &node](QStringView name, bool) {
+        int child = findChild(node, name);
+        if (child < 0) {
+            child = allocateNode(name.toString(), node);
+            auto &children = m_nodes[node].children;
+            auto pos = std::lower_bound(children.begin(), children.end(), name,
+                                        [](const std::pair<QString, int> &entry, QStringView key) {
+                                            return QStringView(entry.first).compare(key) < 0;
+                                        });
+            children.insert(pos, std::make_pair(m_nodes[child].name, child));
+        }
+        node = child;
+        return true;
+    });
+
+    Node &target = m_nodes[node];
+    if (!target.terminal) {
+        target.terminal = true;
+        ++m_size;
+    }
+    target.path = path;
+}
+
+bool PathIndex::remove(const QString &path)
+{
+    int node = findNode(path);
+    if (node < 0 || !m_nodes[node].terminal)
+        return false;
+
+    m_nodes[node].terminal = false;
+    m_nodes[node].path.clear();
+    --m_size;
+
+    // 自底向上回收不再需要的叶子节点
+    while (node > 0 && !m_nodes[node].terminal && m_nodes[node].children.empty()) {
+        const int parent = m_nodes[node].parent;
+        auto &siblings = m_nodes[parent].children;
+        siblings.erase(std::remove_if(siblings.begin(), siblings.end(),
+                                      [node](const std::pair<QString, int> &entry) {
+                                          return entry.second == node;
+                                      }),
+                       siblings.end());
+        releaseNode(node);
+        node = parent;
+    }
+    return true;
+}
+
+bool PathIndex::contains(const QString &path) const
+{
+    const int node = findNode(path);
+    return node >= 0 && m_nodes[node].terminal;
+}
+
+void PathIndex::clear()
+{
+    m_nodes.clear();
+    m_freeNodes.clear();
+    m_nodes.emplace_back();
+    m_size = 0;
+}
+
+QString PathIndex::longestPrefix(const QString &path, bool includeSelf) const
+{
+    if (m_size == 0 || path.isEmpty())
+        return QString();
+
+    int best = m_nodes[0].terminal ? 0 : -1;
+    int node = 0;
+    forEachComponent(path, [this, &node, &best, includeSelf](QStringView name, bool last) {
+        node = findChild(node, name);
+        if (node < 0)
+            return false;
+        if (m_nodes[node].terminal && (includeSelf || !last))
+            best = node;
+        return true;
+    });
+
+    return best < 0 ? QString() : m_nodes[best].path;
+}
+
+QStringList PathIndex::paths() const
+{
+    QStringList result;
+    result.reserve(m_size);
+    for (const Node &node : m_nodes) {
+        if (node.terminal)
+            result.append(node.path);
+    }
+    return result;
+}
+
+int PathIndex::findChild(int node, QStringView name) const
+{
+    const auto &children = m_nodes[node].children;
+    auto it = std::lower_bound(children.begin(), children.end(), name,
+                               [](const std::pair<QString, int> &entry, QStringView key) {
+                                   return QStringView(entry.first).compare(key) < 0;
+                               });
+    if (it == children.end() || QStringView(it->first).compare(name) != 0)
+        return -1;
+    return it->second;
+}
+
+int PathIndex::findNode(const QString &path) const
+{
+    if (path.isEmpty())
+        return -1;
+
+    int node = 0;
+    forEachComponent(path, [this, &node](QStringView name, bool) {
+        node = findChild(node, name);
+        return node >= 0;
+    });
+    return node;
+}
+
+int PathIndex::allocateNode(const QString &name, int parent)
+{
+    int index;
+    if (!m_freeNodes.empty()) {
+        index = m_freeNodes.back();
+        m_freeNodes.pop_back();
+        m_nodes[index] = Node();
+    } else {
+        index = static_cast<int>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+    m_nodes[index].name = name;
+    m_nodes[index].parent = parent;
+    return index;
+}
+
+void PathIndex::releaseNode(int node)
+{
+    m_nodes[node] = Node();
+    m_nodes[node].parent = -1;
+    m_freeNodes.push_back(node);
+}
+
+}   // namespace Global
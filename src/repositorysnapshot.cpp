@@ -0,0 +1,261 @@
+#include "repositorysnapshot.h"
+
+#include <string>
+#include <utility>
+#include <unordered_set>
+
+namespace Global {
+
+namespace {
+
+std::shared_ptr<const StatusTable> buildTable(const QString &repositoryPath,
+                                              const RepositorySnapshot::VersionHash &versions)
+{
+    auto table { std::make_shared<StatusTable>() };
+    std::vector<std::pair<QByteArray, std::uint8_t>> keys;
+    keys.reserve(static_cast<std::size_t>(versions.size()));
+
+    std::size_t arenaBytes { 0 };
+    const int prefixLength { static_cast<int>(repositoryPath.size()) + 1 };
+    for (auto it = versions.constBegin(); it != versions.constEnd(); ++it) {
+        const QString &path { it.key() };
+        QByteArray key;
+        if (path.size() >= prefixLength)
+            key = QStringView(path).mid(prefixLength).toUtf8();
+        arenaBytes += static_cast<std::size_t>(key.size());
+        keys.emplace_back(std::move(key), static_cast<std::uint8_t>(it.value()));
+    }
+
+    table->reserve(keys.size(), arenaBytes);
+    for (const auto &entry : keys)
+        table->insert(std::string_view(entry.first.constData(), static_cast<std::size_t>(entry.first.size())), entry.second);
+    return table;
+}
+
+template<typename Bytes>
+inline std::string_view toView(const Bytes &bytes)
+{
+    return std::string_view(bytes.constData(), static_cast<std::size_t>(bytes.size()));
+}
+
+/**
+ * @brief 把 UTF-16 路径编码为 UTF-8 追加到 out，与 QString::toUtf8() 的结果一致
+ * @return 遇到不成对的代理项时返回 false，由调用方回退到 toUtf8()
+ */
+template<typename Buffer>
+bool appendUtf8(QStringView text, Buffer *out)
+{
+    const qsizetype length { text.size() };
+    for (qsizetype i = 0; i < length; ++i) {
+        const uint unit { text[i].unicode() };
+        if (unit < 0x80) {
+            out->append(static_cast<char>(unit));
+        } else if (unit < 0x800) {
+            out->append(static_cast<char>(0xc0 | (unit >> 6)));
+            out->append(static_cast<char>(0x80 | (unit & 0x3f)));
+        } else if (!QChar::isSurrogate(unit)) {
+            out->append(static_cast<char>(0xe0 | (unit >> 12)));
+            out->append(static_cast<char>(0x80 | ((unit >> 6) & 0x3f)));
+            out->append(static_cast<char>(0x80 | (unit & 0x3f)));
+        } else if (QChar::isHighSurrogate(unit) && i + 1 < length && text[i + 1].isLowSurrogate()) {
+            const uint codePoint { QChar::surrogateToUcs4(text[i], text[i + 1]) };
+            ++i;
+            out->append(static_cast<char>(0xf0 | (codePoint >> 18)));
+            out->append(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f)));
+            out->append(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f)));
+            out->append(static_cast<char>(0x80 | (codePoint & 0x3f)));
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+}   // namespace
+
+RepositorySnapshot::RepositorySnapshot(const QString &repositoryPath, VersionHash versions, quint64 generation)
+    : m_repositoryPath { repositoryPath },
+      m_generation { generation },
+      m_base { buildTable(repositoryPath, versions) },
+      m_size { static_cast<int>(m_base->size()) }
+{
+}
+
+RepositorySnapshot::RepositorySnapshot(const QString &repositoryPath, std::shared_ptr<const StatusTable> table, quint64 generation)
+    : m_repositoryPath { repositoryPath },
+      m_generation { generation },
+      m_base { std::move(table) },
+      m_size { static_cast<int>(m_base->size()) }
+{
+}
+
+std::shared_ptr<const RepositorySnapshot> RepositorySnapshot::applied(const VersionDelta &delta) const
+{
+    std::shared_ptr<RepositorySnapshot> next { new RepositorySnapshot };
+    next->m_repositoryPath = m_repositoryPath;
+    next->m_generation = delta.generation;
+    next->m_base = m_base;
+    next->m_overlay = m_overlay;
+    next->m_removed = m_removed;
+    next->m_size = m_size;
+
+    for (auto it = delta.changed.constBegin(); it != delta.changed.constEnd(); ++it) {
+        if (!next->contains(it.key()))
+            ++next->m_size;
+        next->m_overlay.insert(it.key(), it.value());
+        next->m_removed.remove(it.key());
+    }
+
+    KeyBuffer key;
+    for (const QString &path : delta.removed) {
+        if (!next->contains(path))
+            continue;
+        next->m_overlay.remove(path);
+        if (relativeKey(path, &key) && m_base->find(toView(key)))
+            next->m_removed.insert(path);
+        --next->m_size;
+    }
+
+    // 覆盖层过大时合并回基础表，均摊后单次更新仍与变化量成正比
+    if (next->m_overlay.size() + next->m_removed.size() > MAX_OVERLAY_SIZE) {
+        next->m_base = next->compactedTable();
+        next->m_overlay.clear();
+        next->m_removed.clear();
+    }
+
+    return next;
+}
+
+std::shared_ptr<const StatusTable> RepositorySnapshot::compactedTable() const
+{
+    if (m_overlay.isEmpty() && m_removed.isEmpty())
+        return m_base;
+
+    // 被覆盖的键连续存放，集合只保存视图，遍历基础表时不为每个条目构造字符串
+    KeyBuffer key;
+    std::string shadowedKeys;
+    std::vector<std::pair<std::size_t, std::size_t>> shadowedRanges;
+    shadowedRanges.reserve(static_cast<std::size_t>(m_overlay.size() + m_removed.size()));
+    auto shadow = [this, &shadowedKeys, &shadowedRanges, &key](const QString &path) {
+        if (!relativeKey(path, &key))
+            return;
+        shadowedRanges.emplace_back(shadowedKeys.size(), static_cast<std::size_t>(key.size()));
+        shadowedKeys.append(key.constData(), static_cast<std::size_t>(key.size()));
+    };
+    for (auto it = m_overlay.constBegin(); it != m_overlay.constEnd(); ++it)
+        shadow(it.key());
+    for (const QString &path : m_removed)
+        shadow(path);
+
+    std::unordered_set<std::string_view> shadowed;
+    shadowed.reserve(shadowedRanges.size());
+    for (const auto &range : shadowedRanges)
+        shadowed.emplace(shadowedKeys.data() + range.first, range.second);
+
+    auto merged { std::make_shared<StatusTable>() };
+    merged->reserve(static_cast<std::size_t>(m_size), m_base->memoryUsage() / 2);
+    m_base->forEach([&merged, &shadowed](std::string_view relativePath, std::uint8_t state) {
+        if (shadowed.find(relativePath) == shadowed.end())
+            merged->insert(relativePath, state);
+    });
+    for (auto it = m_overlay.constBegin(); it != m_overlay.constEnd(); ++it) {
+        if (relativeKey(it.key(), &key))
+            merged->insert(toView(key), static_cast<std::uint8_t>(it.value()));
+    }
+    return merged;
+}
+
+ItemVersion RepositorySnapshot::version(const QString &filePath) const
+{
+    auto overlayIt = m_overlay.constFind(filePath);
+    if (overlayIt != m_overlay.constEnd())
+        return overlayIt.value();
+    if (m_removed.contains(filePath))
+        return ItemVersion::NormalVersion;
+
+    KeyBuffer key;
+    std::uint8_t state { 0 };
+    if (relativeKey(filePath, &key) && m_base->find(toView(key), &state))
+        return static_cast<ItemVersion>(state);
+    return ItemVersion::NormalVersion;
+}
+
+bool RepositorySnapshot::contains(const QString &filePath) const
+{
+    if (m_overlay.contains(filePath))
+        return true;
+    if (m_removed.contains(filePath))
+        return false;
+
+    KeyBuffer key;
+    return relativeKey(filePath, &key) && m_base->find(toView(key));
+}
+
+int RepositorySnapshot::size() const
+{
+    return m_size;
+}
+
+void RepositorySnapshot::forEach(const std::function<void(const QString &, ItemVersion)> &visitor) const
+{
+    m_base->forEach([this, &visitor](std::string_view relativePath, std::uint8_t state) {
+        const QString &path { absolutePath(relativePath) };
+        if (m_overlay.contains(path) || m_removed.contains(path))
+            return;
+        visitor(path, static_cast<ItemVersion>(state));
+    });
+    for (auto it = m_overlay.constBegin(); it != m_overlay.constEnd(); ++it)
+        visitor(it.key(), it.value());
+}
+
+RepositorySnapshot::VersionHash RepositorySnapshot::toHash() const
+{
+    VersionHash result;
+    result.reserve(m_size);
+    forEach([&result](const QString &path, ItemVersion version) {
+        result.insert(path, version);
+    });
+    return result;
+}
+
+std::size_t RepositorySnapshot::memoryUsage() const
+{
+    // 覆盖层有上限，这里按条目粗略估算
+    constexpr std::size_t kOverlayEntryCost { 128 };
+    return sizeof(*this) + m_base->memoryUsage()
+            + static_cast<std::size_t>(m_overlay.size() + m_removed.size()) * kOverlayEntryCost;
+}
+
+bool RepositorySnapshot::relativeKey(const QString &filePath, KeyBuffer *key) const
+{
+    const int repositoryLength { static_cast<int>(m_repositoryPath.size()) };
+    if (filePath.size() == repositoryLength) {
+        if (filePath != m_repositoryPath)
+            return false;
+        key->clear();   // 仓库根目录自身以空路径存储
+        return true;
+    }
+
+    if (filePath.size() <= repositoryLength || filePath.at(repositoryLength) != QLatin1Char('/')
+        || !filePath.startsWith(m_repositoryPath))
+        return false;
+
+    const QStringView relativePath { QStringView(filePath).mid(repositoryLength + 1) };
+    key->clear();
+    if (!appendUtf8(relativePath, key)) {
+        const QByteArray &utf8 { relativePath.toUtf8() };
+        key->clear();
+        key->append(utf8.constData(), static_cast<int>(utf8.size()));
+    }
+    return true;
+}
+
+QString RepositorySnapshot::absolutePath(std::string_view relativePath) const
+{
+    if (relativePath.empty())
+        return m_repositoryPath;
+    return m_repositoryPath + QLatin1Char('/')
+            + QString::fromUtf8(relativePath.data(), static_cast<int>(relativePath.size()));
+}
+
+}   // namespace Global
@@ -0,0 +1,141 @@
+#include "statustable.h"
+
+namespace Global {
+
+// 条目数组按字节写入快照文件，布局改变时需要同时提升快照格式版本
+static_assert(StatusTable::entrySize() == 12, "StatusTable::Entry must not contain implicit padding");
+
+void StatusTable::reserve(std::size_t entries, std::size_t arenaBytes)
+{
+    m_entries.reserve(entries);
+    m_arena.reserve(arenaBytes);
+
+    const std::size_t slotCount { slotCountFor(entries) };
+    if (slotCount > m_slots.size())
+        rehash(slotCount);
+}
+
+void StatusTable::insert(std::string_view relativePath, std::uint8_t state)
+{
+    // Linux 下 PATH_MAX 为 4096，超长路径不可能出现在仓库中
+    if (relativePath.size() > UINT16_MAX)
+        return;
+
+    const std::uint32_t hash { hashOf(relativePath) };
+    const std::int64_t existing { findEntry(relativePath, hash) };
+    if (existing >= 0) {
+        m_entries[static_cast<std::size_t>(existing)].state = state;
+        return;
+    }
+
+    // 负载因子保持在 1/2 以下，探测链足够短
+    if ((m_entries.size() + 1) * 2 > m_slots.size())
+        rehash(m_slots.empty() ? 16 : m_slots.size() * 2);
+
+    const Entry entry { static_cast<std::uint32_t>(m_arena.size()), hash,
+                        static_cast<std::uint16_t>(relativePath.size()), state, 0 };
+    m_arena.append(relativePath.data(), relativePath.size());
+    m_entries.push_back(entry);
+
+    const std::size_t mask { m_slots.size() - 1 };
+    std::size_t slot { hash & mask };
+    while (m_slots[slot] != 0)
+        slot = (slot + 1) & mask;
+    m_slots[slot] = static_cast<std::uint32_t>(m_entries.size());
+}
+
+bool StatusTable::find(std::string_view relativePath, std::uint8_t *state) const
+{
+    const std::int64_t index { findEntry(relativePath, hashOf(relativePath)) };
+    if (index < 0)
+        return false;
+    if (state)
+        *state = m_entries[static_cast<std::size_t>(index)].state;
+    return true;
+}
+
+StatusTable::RawLayout StatusTable::rawLayout() const
+{
+    RawLayout layout;
+    layout.entries = m_entries.data();
+    layout.entryCount = m_entries.size();
+    layout.arena = m_arena.data();
+    layout.arenaBytes = m_arena.size();
+    return layout;
+}
+
+bool StatusTable::fromRawLayout(const RawLayout &layout, StatusTable *table)
+{
+    // 数据来自磁盘，逐项校验后才能使用
+    if (layout.arenaBytes > UINT32_MAX || layout.entryCount >= UINT32_MAX)
+        return false;
+
+    table->m_entries.resize(layout.entryCount);
+    if (layout.entryCount > 0)
+        std::memcpy(table->m_entries.data(), layout.entries, layout.entryCount * sizeof(Entry));
+    table->m_arena.assign(layout.arena, layout.arenaBytes);
+
+    // 哈希值按键重新计算，索引由校验过的条目重建
+    for (Entry &entry : table->m_entries) {
+        if (static_cast<std::size_t>(entry.offset) + entry.length > layout.arenaBytes)
+            return false;
+        entry.hash = hashOf(std::string_view(table->m_arena.data() + entry.offset, entry.length));
+    }
+    table->rehash(slotCountFor(layout.entryCount));
+    return true;
+}
+
+std::size_t StatusTable::memoryUsage() const
+{
+    return sizeof(*this) + m_arena.capacity()
+            + m_entries.capacity() * sizeof(Entry)
+            + m_slots.capacity() * sizeof(std::uint32_t);
+}
+
+std::uint32_t StatusTable::hashOf(std::string_view key)
+{
+    // FNV-1a
+    std::uint32_t hash { 2166136261u };
+    for (const char c : key) {
+        hash ^= static_cast<std::uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+std::int64_t StatusTable::findEntry(std::string_view key, std::uint32_t hash) const
+{
+    if (m_slots.empty())
+        return -1;
+
+    const std::size_t mask { m_slots.size() - 1 };
+    for (std::size_t slot { hash & mask }; m_slots[slot] != 0; slot = (slot + 1) & mask) {
+        const Entry &entry { m_entries[m_slots[slot] - 1] };
+        if (entry.hash == hash && entry.length == key.size()
+            && key.compare(0, key.size(), m_arena.data() + entry.offset, entry.length) == 0)
+            return m_slots[slot] - 1;
+    }
+    return -1;
+}
+
+std::size_t StatusTable::slotCountFor(std::size_t entries)
+{
+    std::size_t slotCount { 16 };
+    while (slotCount < entries * 2)
+        slotCount <<= 1;
+    return slotCount;
+}
+
+void StatusTable::rehash(std::size_t slotCount)
+{
+    m_slots.assign(slotCount, 0);
+    const std::size_t mask { slotCount - 1 };
+    for (std::size_t i = 0; i < m_entries.size(); ++i) {
+        std::size_t slot { m_entries[i].hash & mask };
+        while (m_slots[slot] != 0)
+            slot = (slot + 1) & mask;
+        m_slots[slot] = static_cast<std::uint32_t>(i + 1);
+    }
+}
+
+}   // namespace Global